@@ -0,0 +1,910 @@
+//
+// 엔진 핫 패스 마이크로 벤치마크.
+//
+// 사용법:
+//   ./bench                       모든 벤치마크를 돌리고 bench_baseline.txt와 비교
+//   ./bench --save                결과를 bench_baseline.txt에 저장
+//   ./bench --baseline FILE       비교/저장할 베이스라인 파일 지정
+//   ./bench --threshold 0.15      최솟값이 베이스라인보다 15% 넘게 느려지면 실패 (기본값)
+//   ./bench signature [N]         고정된 포지션들에서 깊이 N까지의 perft + 탐색 노드 수 출력 (기본값 3)
+//   ./bench physical [GRAB_US] [SQUARE_US] [RELEASE_US]
+//                                 가상 액추에이터로 물리 명령 파이프라인을 돌려봄
+//   ./bench sessions [GAMES] [WORKERS]
+//                                 ChessPosition 규칙 함수를 엔진과 비교한 후,
+//                                 게임 세션 호스트에서 GAMES개의 게임을 동시에 돌리는 부하 테스트
+//   ./bench packed [FILE]         고정 포지션들에서 나온 포지션을 압축 파일로 쓰고 다시 읽어서 확인
+//   ./bench features              배치 특징 계산 커널들을 엔진 결과와 비교하고 초당 포지션 수 출력
+//
+// 베이스라인보다 느려졌거나 노드 수 시그니처가 달라졌으면 종료 코드 1로 끝남.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "chess_engine.cpp"
+#include "chess_engine_print.cpp"
+#include "chess_position.h"
+#include "chess_session.h"
+#include "chess_packed.h"
+#include "chess_search.h"
+#include "chess_notation.h"
+#include "chess_batch.h"
+
+
+const char* const BENCH_POSITIONS[] = {
+	// 시작 포지션
+	"RNBQKBNR"
+	"PPPPPPPP"
+	"        "
+	"        "
+	"        "
+	"        "
+	"pppppppp"
+	"rnbqkbnr",
+
+	// 오프닝이 끝난 중반
+	"R BQKB R"
+	"PPP  PPP"
+	"  N  N  "
+	"   PP   "
+	"   pp   "
+	"  n  n  "
+	"ppp  ppp"
+	"r bqkb r",
+
+	// 양쪽 다 캐슬링할 수 있는 포지션
+	"R   K  R"
+	"PPPQ PPP"
+	"  N  N  "
+	"    P   "
+	"    p   "
+	"  n  n  "
+	"pppq ppp"
+	"r   k  r",
+
+	// 엔드게임
+	"    K   "
+	"  P     "
+	"        "
+	"   R    "
+	"     q  "
+	"        "
+	"     pp "
+	"      k ",
+};
+const int BENCH_POSITION_COUNT = sizeof(BENCH_POSITIONS) / sizeof(BENCH_POSITIONS[0]);
+
+const int BENCH_REPETITIONS = 10;
+const double BENCH_WARMUP_MS = 20.0;
+const double BENCH_REPETITION_MS = 20.0;
+
+// 컴파일러가 벤치마크 대상 코드를 지워버리지 못하게 결과를 여기에 더함
+volatile long long benchSink;
+
+// 힙 할당 횟수. 세션 부하 테스트에서 수 하나당 할당이 몇 번인지 보려고 전역 new를 감쌈
+// (인라인되면 new와 free()가 짝이 안 맞는다는 경고가 나오므로 인라인하지 않음)
+std::atomic<unsigned long long> benchAllocations(0);
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+	benchAllocations.fetch_add(1, std::memory_order_relaxed);
+	void* pointer = malloc(size > 0 ? size : 1);
+	if(pointer == nullptr) throw std::bad_alloc();
+	return pointer;
+}
+
+__attribute__((noinline)) void operator delete(void* pointer) noexcept
+{
+	free(pointer);
+}
+
+__attribute__((noinline)) void operator delete(void* pointer, size_t) noexcept
+{
+	free(pointer);
+}
+
+
+struct BenchResult
+{
+	std::string name;
+	double meanNs, stddevNs, minNs;
+};
+
+
+/**
+ * ChessEngine의 private 함수에 접근하기 위한 구조체. (ChessEngine의 friend)
+ */
+struct ChessBench
+{
+	static void updateCheckmate(ChessEngine& engine)
+	{
+		engine.updateCheckmate();
+	}
+};
+
+
+double elapsedNs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+/**
+ * 반복마다 잰 op 하나당 시간들의 평균, 표준편차, 최솟값.
+ */
+BenchResult summarizeBench(const std::string& name, const double* samples)
+{
+	BenchResult result = { name, 0, 0, samples[0] };
+	for(int r = 0; r < BENCH_REPETITIONS; r++)
+	{
+		result.meanNs += samples[r] / BENCH_REPETITIONS;
+		result.minNs = samples[r] < result.minNs ? samples[r] : result.minNs;
+	}
+	for(int r = 0; r < BENCH_REPETITIONS; r++)
+	{
+		double d = samples[r] - result.meanNs;
+		result.stddevNs += d * d / BENCH_REPETITIONS;
+	}
+	result.stddevNs = sqrt(result.stddevNs);
+	return result;
+}
+
+
+/**
+ * body()를 BENCH_WARMUP_MS 동안 돌려서 예열한 후, 한 번 반복에 BENCH_REPETITION_MS 정도 걸리도록
+ * 반복 횟수를 정하고 BENCH_REPETITIONS 번 측정함.
+ * @param opsPerCall body() 한 번에 들어있는 op 개수
+ */
+template<typename Body>
+BenchResult runBench(const std::string& name, int opsPerCall, Body body)
+{
+	long long warmupCalls = 0;
+	auto warmupStart = std::chrono::steady_clock::now();
+	while(elapsedNs(warmupStart) < BENCH_WARMUP_MS * 1e6)
+	{
+		body();
+		warmupCalls++;
+	}
+	double nsPerCall = elapsedNs(warmupStart) / warmupCalls;
+	long long calls = (long long) (BENCH_REPETITION_MS * 1e6 / nsPerCall);
+	if(calls < 1) calls = 1;
+
+	double samples[BENCH_REPETITIONS];
+	for(int r = 0; r < BENCH_REPETITIONS; r++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for(long long i = 0; i < calls; i++) body();
+		samples[r] = elapsedNs(start) / (calls * opsPerCall);
+	}
+	return summarizeBench(name, samples);
+}
+
+
+/**
+ * body()가 상태를 바꾸는 경우(히스토리가 쌓이는 등)에 쓰는 runBench.
+ * body()를 부를 때마다 reset()으로 상태를 되돌리고, reset()은 시간을 재지 않음.
+ * (body() 한 번마다 시간을 따로 재기 때문에, body()는 시계 읽는 시간보다 충분히 길어야 함)
+ */
+template<typename Body, typename Reset>
+BenchResult runBench(const std::string& name, int opsPerCall, Body body, Reset reset)
+{
+	long long warmupCalls = 0;
+	double warmupNs = 0;
+	auto warmupStart = std::chrono::steady_clock::now();
+	while(elapsedNs(warmupStart) < BENCH_WARMUP_MS * 1e6)
+	{
+		auto start = std::chrono::steady_clock::now();
+		body();
+		warmupNs += elapsedNs(start);
+		reset();
+		warmupCalls++;
+	}
+	long long calls = (long long) (BENCH_REPETITION_MS * 1e6 / (warmupNs / warmupCalls));
+	if(calls < 1) calls = 1;
+
+	double samples[BENCH_REPETITIONS];
+	for(int r = 0; r < BENCH_REPETITIONS; r++)
+	{
+		double ns = 0;
+		for(long long i = 0; i < calls; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			body();
+			ns += elapsedNs(start);
+			reset();
+		}
+		samples[r] = ns / (calls * opsPerCall);
+	}
+	return summarizeBench(name, samples);
+}
+
+
+/**
+ * 깊이 depth까지 둘 수 있는 수를 모두 둬보고, 끝 노드 개수를 세는 함수.
+ * 엔진 최적화 후에도 이 값이 같아야 움직임 생성 결과가 바뀌지 않았다고 볼 수 있음.
+ */
+unsigned long long perft(ChessEngine& engine, int depth)
+{
+	ChessMove moves[MAX_MOVES];
+	int moveCount = engine.generateMoves(moves);
+	if(depth <= 1) return moveCount;
+
+	unsigned long long nodes = 0;
+	for(int i = 0; i < moveCount; i++)
+	{
+		engine.playMove(moves[i]);
+		nodes += perft(engine, depth - 1);
+		engine.undo();
+	}
+	return nodes;
+}
+
+
+unsigned long long benchSignature(int depth)
+{
+	unsigned long long total = 0;
+	for(int p = 0; p < BENCH_POSITION_COUNT; p++)
+	{
+		ChessEngine engine;
+		engine.resetBoard(BENCH_POSITIONS[p]);
+		engine.setPhysicalEnabled(false);
+		unsigned long long nodes = perft(engine, depth);
+
+		// 탐색 노드 수도 더해서, 최적화 후에도 탐색이 똑같이 동작하는지 확인함
+		ChessSearch search;
+		SearchResult result = search.search(engine, { depth, 0 }, nullptr);
+		printf("position %d: %llu perft nodes, %llu search nodes\n", p, nodes, result.nodes);
+		total += nodes + result.nodes;
+	}
+	return total;
+}
+
+
+/**
+ * 포지션의 (src, dst) 쌍 중에서, src에 현재 턴의 말이 있는 것만 모아줌.
+ */
+std::vector<ChessMove> collectCandidates(ChessEngine& engine)
+{
+	std::vector<ChessMove> candidates;
+	for(int srcY = 0; srcY < 8; srcY++) for(int srcX = 0; srcX < 8; srcX++)
+	{
+		ChessPiece* piece = engine.getPieceAt(srcX, srcY);
+		if(piece == nullptr || piece->color != engine.getTurn()) continue;
+		for(int dstY = 0; dstY < 8; dstY++) for(int dstX = 0; dstX < 8; dstX++)
+		{
+			candidates.push_back({ (signed char) srcX, (signed char) srcY, (signed char) dstX, (signed char) dstY });
+		}
+	}
+	return candidates;
+}
+
+
+std::vector<BenchResult> runAllBenches()
+{
+	std::vector<BenchResult> results;
+	std::vector<ChessEngine> engines(BENCH_POSITION_COUNT);
+	for(int p = 0; p < BENCH_POSITION_COUNT; p++) engines[p].resetBoard(BENCH_POSITIONS[p]);
+
+	// checkPath: 상태별로 하나씩
+	struct PathCase { const char* name; int position, srcX, srcY, dstX, dstY; PathState expected; };
+	const PathCase pathCases[] = {
+		{ "checkPath/STRAIGHT_LINE", 3, 3, 3, 3, 7, PathState::STRAIGHT_LINE },
+		{ "checkPath/DIAGONAL",      3, 5, 4, 2, 1, PathState::DIAGONAL },
+		{ "checkPath/JUMP",          0, 1, 7, 2, 5, PathState::JUMP },
+		{ "checkPath/BLOCKED",       0, 0, 0, 0, 7, PathState::BLOCKED },
+	};
+	for(const PathCase& c : pathCases)
+	{
+		ChessEngine& engine = engines[c.position];
+		if(engine.checkPath(c.srcX, c.srcY, c.dstX, c.dstY) != c.expected)
+		{
+			printf("%s: unexpected path state\n", c.name);
+			exit(1);
+		}
+		results.push_back(runBench(c.name, 1, [&]() {
+			benchSink += engine.checkPath(c.srcX, c.srcY, c.dstX, c.dstY);
+		}));
+	}
+
+	// isPieceMovableTo: 현재 턴의 말에서 출발하는 모든 (src, dst) 쌍
+	for(int checkCheckmate = 0; checkCheckmate <= 1; checkCheckmate++)
+	{
+		for(int p = 0; p < BENCH_POSITION_COUNT; p++)
+		{
+			ChessEngine& engine = engines[p];
+			std::vector<ChessMove> candidates = collectCandidates(engine);
+			std::string name = std::string("isPieceMovableTo/") + (checkCheckmate ? "checkmate" : "nocheckmate")
+				+ "/pos" + std::to_string(p);
+			results.push_back(runBench(name, candidates.size(), [&]() {
+				for(const ChessMove& m : candidates)
+				{
+					benchSink += engine.isPieceMovableTo(m.srcX, m.srcY, m.dstX, m.dstY, true, checkCheckmate);
+				}
+			}));
+		}
+	}
+
+	// simulateCheckmate: 둘 수 있는 모든 수
+	for(int p = 0; p < BENCH_POSITION_COUNT; p++)
+	{
+		ChessEngine& engine = engines[p];
+		ChessMove moves[MAX_MOVES];
+		int moveCount = engine.generateMoves(moves);
+		results.push_back(runBench("simulateCheckmate/pos" + std::to_string(p), moveCount, [&]() {
+			for(int i = 0; i < moveCount; i++)
+			{
+				const ChessMove& m = moves[i];
+				benchSink += engine.simulateCheckmate(engine.getTurn(), m.srcX, m.srcY, m.dstX, m.dstY);
+			}
+		}));
+	}
+
+	for(int p = 0; p < BENCH_POSITION_COUNT; p++)
+	{
+		ChessEngine& engine = engines[p];
+		results.push_back(runBench("updateCheckmate/pos" + std::to_string(p), 1, [&]() {
+			ChessBench::updateCheckmate(engine);
+			benchSink += engine.isCheckmate(PieceColor::WHITE);
+		}));
+	}
+
+	// movePieceTo: 나이트를 나갔다가 다시 들어오게 해서 4수마다 원래 포지션으로 돌아오게 함.
+	// 둔 수는 히스토리에 쌓이므로, 잰 후에 되돌려서 히스토리가 늘어나지 않게 함
+	auto undoFour = [](ChessEngine& engine) {
+		for(int i = 0; i < 4; i++) engine.undo();
+	};
+	{
+		ChessEngine engine;
+		results.push_back(runBench("movePieceTo", 4, [&]() {
+			benchSink += engine.movePieceTo(6, 7, 5, 5);
+			benchSink += engine.movePieceTo(6, 0, 5, 2);
+			benchSink += engine.movePieceTo(5, 5, 6, 7);
+			benchSink += engine.movePieceTo(5, 2, 6, 0);
+		}, [&]() { undoFour(engine); }));
+	}
+
+	// 탐색에서 쓰는 playMove + undo. 모든 수를 한 번씩 두고 되돌림
+	for(int p = 0; p < BENCH_POSITION_COUNT; p++)
+	{
+		ChessEngine& engine = engines[p];
+		ChessMove moves[MAX_MOVES];
+		int moveCount = engine.generateMoves(moves);
+		results.push_back(runBench("playMove+undo/pos" + std::to_string(p), moveCount, [&]() {
+			for(int i = 0; i < moveCount; i++)
+			{
+				engine.playMove(moves[i]);
+				engine.undo();
+			}
+			benchSink += engine.getHash();
+		}));
+	}
+
+	// 물리 명령 큐가 연결된 상태의 movePieceTo (액추에이터는 시간이 안 걸리게 설정)
+	{
+		SimulatedActuator actuator(0, 0, 0);
+		PhysicalBoard physicalBoard(actuator);
+		ChessEngine engine;
+		engine.setPhysicalBoard(&physicalBoard);
+		results.push_back(runBench("movePieceTo/physicalQueue", 4, [&]() {
+			benchSink += engine.movePieceTo(6, 7, 5, 5);
+			benchSink += engine.movePieceTo(6, 0, 5, 2);
+			benchSink += engine.movePieceTo(5, 5, 6, 7);
+			benchSink += engine.movePieceTo(5, 2, 6, 0);
+		}, [&]() { undoFour(engine); }));
+	}
+
+	{
+		ChessPosition position;
+		PackedPosition packed;
+		engines[1].getPosition(position);
+		results.push_back(runBench("packPosition", 1, [&]() {
+			benchSink += packPosition(position, packed);
+		}));
+		results.push_back(runBench("unpackPosition", 1, [&]() {
+			unpackPosition(packed, position);
+			benchSink += position.board[0];
+		}));
+	}
+
+	{
+		ChessEngine engine;
+		results.push_back(runBench("resetBoard", 1, [&]() {
+			engine.resetBoard();
+		}));
+	}
+
+	{
+		ChessEngine& engine = engines[1];
+		std::ostringstream out;
+		results.push_back(runBench("printBoard", 1, [&]() {
+			out.str("");
+			engine.printBoard(out, 2, 5);
+			benchSink += out.tellp();
+		}));
+	}
+
+	return results;
+}
+
+
+/**
+ * 가상 액추에이터에 느린 모터 시간을 설정해두고 수를 연달아 둬서,
+ * 엔진 쪽 movePieceTo가 모터를 기다리지 않는지와 파이프라인 처리량을 확인함.
+ */
+int benchPhysical(int grabMicros, int microsPerSquare, int releaseMicros)
+{
+	// 큐가 가득 차면 submit()이 기다리기 때문에, 한 수에 구간이 몇 개씩 나오는 걸 감안해서 적게 둠
+	const int MOVE_COUNT = PhysicalBoard::QUEUE_CAPACITY / 8;
+	SimulatedActuator actuator(grabMicros, microsPerSquare, releaseMicros);
+	PhysicalBoard physicalBoard(actuator);
+	ChessEngine engine;
+	engine.setPhysicalBoard(&physicalBoard);
+
+	double maxMoveNs = 0, plannedSquares = 0, plannedSeconds = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < MOVE_COUNT; i++)
+	{
+		static const int shuffle[4][4] = { { 6, 7, 5, 5 }, { 6, 0, 5, 2 }, { 5, 5, 6, 7 }, { 5, 2, 6, 0 } };
+		const int* m = shuffle[i % 4];
+		auto moveStart = std::chrono::steady_clock::now();
+		engine.movePieceTo(m[0], m[1], m[2], m[3]);
+		double moveNs = elapsedNs(moveStart);
+		plannedSquares += physicalBoard.getLastPlan().carrySquares + physicalBoard.getLastPlan().travelSquares;
+		plannedSeconds += physicalBoard.getLastPlan().seconds;
+		maxMoveNs = moveNs > maxMoveNs ? moveNs : maxMoveNs;
+	}
+	double submitMs = elapsedNs(start) / 1e6;
+	physicalBoard.waitIdle();
+	double totalMs = elapsedNs(start) / 1e6;
+
+	printf("moves: %d, commands executed: %llu, failed: %u\n", MOVE_COUNT,
+		actuator.executedCount.load(), physicalBoard.getFailedCount());
+	printf("planned: %.1f squares of carriage travel, %.1f s of motion\n", plannedSquares, plannedSeconds);
+	printf("engine side: %.2f ms total, worst movePieceTo %.1f us\n", submitMs, maxMoveNs / 1000);
+	printf("actuator side: %.2f ms until idle, simulated busy %.2f ms, %.1f commands/s\n",
+		totalMs, actuator.busyMicros.load() / 1000.0, actuator.executedCount.load() / totalMs * 1000);
+	return physicalBoard.getFailedCount() == 0 ? 0 : 1;
+}
+
+
+/**
+ * 모든 게임에 같은 20수짜리 오프닝(이탈리안, 양쪽 캐슬링 포함)을 두게 해서 처리량을 잼.
+ */
+/**
+ * 고정 포지션들에서 무작위로 게임을 두면서, 나오는 포지션마다 chess_position.h의 함수들이 엔진과 같은 결과를 내는지 확인함.
+ * (모든 (src, dst) 쌍의 가능 여부, 둔 후의 포지션, 둘 수 있는 수가 있는지, 체크 여부)
+ * @return 다른 결과가 나온 횟수
+ */
+int checkPositionRules(int gamesPerPosition, int maxPlies, int& positionCount)
+{
+	int mismatches = 0;
+	positionCount = 0;
+	unsigned long long state = 0x2545F4914F6CDD1DULL;
+	for(int p = 0; p < BENCH_POSITION_COUNT; p++) for(int g = 0; g < gamesPerPosition; g++)
+	{
+		ChessEngine engine;
+		engine.setPhysicalEnabled(false);
+		engine.resetBoard(BENCH_POSITIONS[p]);
+		for(int ply = 0; ply < maxPlies; ply++)
+		{
+			ChessPosition position, expected, actual;
+			engine.getPosition(position);
+			positionCount++;
+
+			for(int src = 0; src < 64; src++) for(int dst = 0; dst < 64; dst++)
+			{
+				ChessMove move = { (signed char) (src % 8), (signed char) (src / 8), (signed char) (dst % 8), (signed char) (dst / 8) };
+				actual = position;
+				bool played = playPositionMove(actual, move);
+				if(played != engine.isPieceMovableTo(move.srcX, move.srcY, move.dstX, move.dstY, true, true))
+				{
+					mismatches++;
+					continue;
+				}
+				if(!played) continue;
+				engine.playMove(move);
+				engine.getPosition(expected);
+				engine.undo();
+				if(memcmp(expected.board, actual.board, 64) != 0 || expected.movedMask != actual.movedMask
+					|| expected.turn != actual.turn)
+				{
+					mismatches++;
+				}
+			}
+			mismatches += hasPositionLegalMove(position) != engine.hasLegalMove();
+			mismatches += isPositionInCheck(position, PieceColor::WHITE) != engine.isCheckmate(PieceColor::WHITE);
+			mismatches += isPositionInCheck(position, PieceColor::BLACK) != engine.isCheckmate(PieceColor::BLACK);
+
+			ChessMove moves[MAX_MOVES];
+			int moveCount = engine.generateMoves(moves);
+			if(moveCount == 0) break;
+			engine.playMove(moves[ZobristKeys::next(state) % moveCount]);
+		}
+	}
+	return mismatches;
+}
+
+
+int benchSessions(int gameCount, int workerCount)
+{
+	int positionCount;
+	int mismatches = checkPositionRules(20, 120, positionCount);
+	printf("position rules: %d positions checked against the engine, %d mismatches\n", positionCount, mismatches);
+
+	const char* const script[] = {
+		"e2e4", "e7e5", "g1f3", "b8c6", "f1c4", "f8c5", "c2c3", "g8f6", "d2d3", "d7d6",
+		"e1g1", "e8g8", "b1d2", "a7a6", "c4b3", "c5a7", "h2h3", "h7h6", "f1e1", "f8e8",
+	};
+	const int plyCount = sizeof(script) / sizeof(script[0]);
+
+	auto start = std::chrono::steady_clock::now();
+	GameSessionHost host(gameCount, workerCount);
+	// 게임 풀과 스레드를 만든 후부터, 요청 큐가 늘어나는 것까지 포함해서 셈
+	unsigned long long allocationsBefore = benchAllocations.load();
+	for(int ply = 0; ply < plyCount; ply++)
+	{
+		const char* s = script[ply];
+		ChessMove move = {
+			(signed char) (s[0] - 'a'), (signed char) ('8' - s[1]), (signed char) (s[2] - 'a'), (signed char) ('8' - s[3])
+		};
+		for(int id = 0; id < gameCount; id++) host.submitMove(id, move);
+	}
+	host.waitIdle();
+	double seconds = elapsedNs(start) / 1e9;
+	unsigned long long allocations = benchAllocations.load() - allocationsBefore;
+
+	int complete = 0;
+	for(int id = 0; id < gameCount; id++) complete += host.getGame(id)->ply == plyCount;
+
+	printf("games: %d, workers: %d, moves accepted: %llu, rejected: %llu, games complete: %d\n",
+		gameCount, workerCount, host.getAcceptedCount(), host.getRejectedCount(), complete);
+	printf("throughput: %.0f moves/s (%.2f s)\n", host.getAcceptedCount() / seconds, seconds);
+	printf("memory: %zu bytes per game state, %.1f bytes per game including queues\n",
+		sizeof(SessionGame), (double) host.getMemoryUsage() / gameCount);
+	printf("heap allocations: %llu while playing, %.4f per accepted move\n",
+		allocations, (double) allocations / host.getAcceptedCount());
+	return complete == gameCount && mismatches == 0 ? 0 : 1;
+}
+
+
+/**
+ * 깊이 depth까지 나오는 모든 포지션을 positions에 모음. (perft와 같은 순서)
+ */
+void collectPositions(ChessEngine& engine, int depth, std::vector<ChessPosition>& positions)
+{
+	ChessPosition position;
+	engine.getPosition(position);
+	positions.push_back(position);
+	if(depth == 0) return;
+
+	ChessMove moves[MAX_MOVES];
+	int moveCount = engine.generateMoves(moves);
+	for(int i = 0; i < moveCount; i++)
+	{
+		engine.playMove(moves[i]);
+		collectPositions(engine, depth - 1, positions);
+		engine.undo();
+	}
+}
+
+
+int benchPacked(const char* path)
+{
+	std::vector<ChessPosition> positions;
+	for(int p = 0; p < BENCH_POSITION_COUNT; p++)
+	{
+		ChessEngine engine;
+		engine.resetBoard(BENCH_POSITIONS[p]);
+		collectPositions(engine, 3, positions);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	PackedPositionWriter writer;
+	if(!writer.open(path))
+	{
+		printf("Cannot open %s\n", path);
+		return 1;
+	}
+	PackedPosition packed;
+	for(const ChessPosition& position : positions)
+	{
+		if(packPosition(position, packed)) writer.write(packed);
+	}
+	writer.close();
+	double writeMs = elapsedNs(start) / 1e6;
+
+	start = std::chrono::steady_clock::now();
+	PackedPositionReader reader;
+	size_t index = 0, mismatches = 0;
+	if(!reader.open(path))
+	{
+		printf("Cannot read %s\n", path);
+		return 1;
+	}
+	while(reader.read(packed))
+	{
+		ChessPosition position;
+		unpackPosition(packed, position);
+		const ChessPosition& expected = positions[index++];
+		if(memcmp(position.board, expected.board, 64) != 0 || position.movedMask != expected.movedMask
+			|| position.turn != expected.turn) mismatches++;
+	}
+	double readMs = elapsedNs(start) / 1e6;
+
+	// 텍스트 포맷은 resetBoard()에 넘기는 64글자 + 차례 + 줄바꿈으로 계산
+	unsigned long long textBytes = positions.size() * 66;
+	printf("positions: %zu written, %zu read back, %zu mismatches\n", positions.size(), index, mismatches);
+	printf("size: %llu bytes text, %zu bytes raw packed, %llu bytes compressed file (%.2f bytes/position, %.1fx smaller than text)\n",
+		textBytes, positions.size() * PACKED_POSITION_SIZE, writer.getByteCount(),
+		(double) writer.getByteCount() / positions.size(), (double) textBytes / writer.getByteCount());
+	printf("write: %.1f ms, read: %.1f ms\n", writeMs, readMs);
+	return mismatches == 0 && index == positions.size() ? 0 : 1;
+}
+
+
+/**
+ * 포지션 하나의 특징. FeatureBlock의 레인 하나와 같음
+ */
+struct BenchFeatures
+{
+	unsigned long long inCheck[2], mobility[2][BATCH_PIECE_TYPES], attacked[2];
+};
+
+
+/**
+ * 엔진으로 position의 특징을 하나씩 계산함. (computeFeatures()와 비교할 기준값)
+ * @param withAttacked false면 공격하는 칸 수는 계산하지 않음 (칸마다 포지션을 다시 넣어야 해서 느림)
+ */
+void referenceFeatures(ChessEngine& engine, const ChessPosition& position, bool withAttacked, BenchFeatures& out)
+{
+	const PieceColor colors[2] = { PieceColor::BLACK, PieceColor::WHITE };
+	out = BenchFeatures();
+	engine.setPosition(position);
+	for(int c = 0; c < 2; c++) out.inCheck[c] = engine.isCheckmate(colors[c]);
+	for(int src = 0; src < 64; src++)
+	{
+		char c = position.board[src];
+		if(c == ' ') continue;
+		int color = (c & 0b00100000) ? BATCH_WHITE : BATCH_BLACK;
+		int type = (const char*) memchr(BATCH_PIECE_SYMBOLS, c & 0b01011111, BATCH_PIECE_TYPES) - BATCH_PIECE_SYMBOLS;
+		for(int dst = 0; dst < 64; dst++)
+		{
+			if(engine.isPieceMovableTo(src % 8, src / 8, dst % 8, dst / 8, false, false)) out.mobility[color][type]++;
+		}
+	}
+	if(!withAttacked) return;
+
+	// 칸마다 상대 폰을 놓아보고 잡을 수 있는 말이 있는지 확인
+	for(int color = 0; color < 2; color++)
+	{
+		for(int square = 0; square < 64; square++)
+		{
+			ChessPosition probe = position;
+			probe.board[square] = color == BATCH_WHITE ? 'P' : 'p';
+			probe.movedMask &= ~(1ULL << square);
+			engine.setPosition(probe);
+			bool hit = false;
+			for(int src = 0; src < 64 && !hit; src++)
+			{
+				char c = probe.board[src];
+				if(c == ' ' || ((c & 0b00100000) ? BATCH_WHITE : BATCH_BLACK) != color) continue;
+				hit = engine.isPieceMovableTo(src % 8, src / 8, square % 8, square / 8, false, false);
+			}
+			out.attacked[color] += hit;
+		}
+	}
+}
+
+
+/**
+ * 고정 포지션들에서 나온 포지션을 모든 커널로 계산해서 엔진 결과와 비교하고, 커널마다 초당 포지션 수를 잼.
+ */
+int benchFeatures()
+{
+	std::vector<ChessPosition> positions;
+	for(int p = 0; p < BENCH_POSITION_COUNT; p++)
+	{
+		ChessEngine engine;
+		engine.resetBoard(BENCH_POSITIONS[p]);
+		collectPositions(engine, 3, positions);
+	}
+	std::vector<PositionBlock> blocks((positions.size() + BATCH_BLOCK - 1) / BATCH_BLOCK);
+	for(size_t i = 0; i < positions.size(); i++) blocks[i / BATCH_BLOCK].add(positions[i]);
+	std::vector<FeatureBlock> features(blocks.size());
+
+	// 공격하는 칸 수는 기준값 계산이 느려서 ATTACKED_STRIDE개 중 하나만 비교함
+	const size_t ATTACKED_STRIDE = 64;
+	ChessEngine engine;
+	engine.setPhysicalEnabled(false);
+	std::vector<BenchFeatures> expected(positions.size());
+	for(size_t i = 0; i < positions.size(); i++)
+	{
+		referenceFeatures(engine, positions[i], i % ATTACKED_STRIDE == 0, expected[i]);
+	}
+	printf("positions: %zu (%zu blocks), best kernel: %s\n", positions.size(), blocks.size(),
+		BATCH_KERNEL_NAMES[(int) bestBatchKernel()]);
+
+	bool failed = false;
+	for(int k = 0; k < 3; k++)
+	{
+		BatchKernel kernel = (BatchKernel) k;
+		if(!isBatchKernelSupported(kernel))
+		{
+			printf("%-8s not supported on this CPU\n", BATCH_KERNEL_NAMES[k]);
+			continue;
+		}
+
+		size_t mismatches = 0;
+		for(size_t b = 0; b < blocks.size(); b++) computeFeatures(blocks[b], features[b], kernel);
+		for(size_t i = 0; i < positions.size(); i++)
+		{
+			const FeatureBlock& f = features[i / BATCH_BLOCK];
+			int lane = i % BATCH_BLOCK;
+			const BenchFeatures& e = expected[i];
+			bool same = true;
+			for(int c = 0; c < 2; c++)
+			{
+				same &= f.inCheck[c][lane] == e.inCheck[c];
+				for(int t = 0; t < BATCH_PIECE_TYPES; t++) same &= f.mobility[c][t][lane] == e.mobility[c][t];
+				if(i % ATTACKED_STRIDE == 0) same &= f.attacked[c][lane] == e.attacked[c];
+			}
+			if(!same && mismatches++ == 0) printf("first mismatch: %s\n", formatFen(positions[i]).c_str());
+		}
+
+		// 전체 블록을 여러 번 돌려서 잼
+		const int ROUNDS = 20;
+		auto start = std::chrono::steady_clock::now();
+		for(int r = 0; r < ROUNDS; r++)
+		{
+			for(size_t b = 0; b < blocks.size(); b++) computeFeatures(blocks[b], features[b], kernel);
+			benchSink += features[r % features.size()].attacked[0][0];
+		}
+		double seconds = elapsedNs(start) / 1e9;
+		printf("%-8s %12.0f positions/s, %zu mismatches\n", BATCH_KERNEL_NAMES[k],
+			positions.size() * ROUNDS / seconds, mismatches);
+		failed |= mismatches > 0;
+	}
+
+	// 엔진으로 하나씩 계산하는 경우 (체크 + 말 종류별 이동 가능한 칸 수)와 비교
+	const size_t ENGINE_SAMPLE = 4096;
+	BenchFeatures single;
+	auto start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < ENGINE_SAMPLE && i < positions.size(); i++)
+	{
+		referenceFeatures(engine, positions[i], false, single);
+		benchSink += single.mobility[BATCH_WHITE][BATCH_PAWN];
+	}
+	double seconds = elapsedNs(start) / 1e9;
+	printf("%-8s %12.0f positions/s (without attacked squares)\n", "engine",
+		(ENGINE_SAMPLE < positions.size() ? ENGINE_SAMPLE : positions.size()) / seconds);
+	return failed ? 1 : 0;
+}
+
+
+int main(int argc, char** argv)
+{
+	const char* baselinePath = "bench_baseline.txt";
+	double threshold = 0.15;
+	bool save = false;
+	int signatureDepth = -1;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--save") == 0) save = true;
+		else if(strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) baselinePath = argv[++i];
+		else if(strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) threshold = atof(argv[++i]);
+		else if(strcmp(argv[i], "physical") == 0)
+		{
+			int timings[3] = { 0, 0, 0 };
+			for(int t = 0; t < 3 && i + 1 < argc; t++) timings[t] = atoi(argv[++i]);
+			return benchPhysical(timings[0], timings[1], timings[2]);
+		}
+		else if(strcmp(argv[i], "sessions") == 0)
+		{
+			int gameCount = i + 1 < argc ? atoi(argv[++i]) : 10000;
+			int workerCount = i + 1 < argc ? atoi(argv[++i]) : std::thread::hardware_concurrency();
+			return benchSessions(gameCount, workerCount > 0 ? workerCount : 1);
+		}
+		else if(strcmp(argv[i], "packed") == 0)
+		{
+			return benchPacked(i + 1 < argc ? argv[++i] : "bench_positions.cpos");
+		}
+		else if(strcmp(argv[i], "features") == 0) return benchFeatures();
+		else if(strcmp(argv[i], "signature") == 0)
+		{
+			signatureDepth = 3;
+			if(i + 1 < argc) signatureDepth = atoi(argv[++i]);
+		}
+		else
+		{
+			printf("Unknown argument: %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	if(signatureDepth > 0)
+	{
+		auto start = std::chrono::steady_clock::now();
+		unsigned long long nodes = benchSignature(signatureDepth);
+		double ms = elapsedNs(start) / 1e6;
+		printf("bench %d: %llu nodes, %.0f ms, %.0f nps\n", signatureDepth, nodes, ms, nodes / ms * 1000);
+		return 0;
+	}
+
+	// 베이스라인 읽기. 형식: "이름 최소ns/op" 또는 "signature 깊이 노드수"
+	std::vector<std::pair<std::string, double>> baseline;
+	int baselineSigDepth = 0;
+	unsigned long long baselineSigNodes = 0;
+	std::ifstream baselineFile(baselinePath);
+	std::string line;
+	while(!save && std::getline(baselineFile, line))
+	{
+		if(line.empty() || line[0] == '#') continue;
+		std::istringstream in(line);
+		std::string name;
+		in >> name;
+		if(name == "signature") in >> baselineSigDepth >> baselineSigNodes;
+		else
+		{
+			double value;
+			if(in >> value) baseline.push_back({ name, value });
+		}
+	}
+
+	std::vector<BenchResult> results = runAllBenches();
+	bool failed = false;
+
+	printf("%-40s %12s %10s %12s %10s\n", "benchmark", "ns/op", "stddev", "min", "baseline");
+	for(const BenchResult& r : results)
+	{
+		double base = -1;
+		for(const auto& b : baseline) if(b.first == r.name) base = b.second;
+
+		printf("%-40s %12.1f %10.1f %12.1f", r.name.c_str(), r.meanNs, r.stddevNs, r.minNs);
+		if(base > 0)
+		{
+			// 평균은 다른 프로세스 영향을 많이 받기 때문에 최솟값끼리 비교함
+			double change = r.minNs / base - 1;
+			printf(" %+9.1f%%", change * 100);
+			if(change > threshold)
+			{
+				printf("  REGRESSION");
+				failed = true;
+			}
+		}
+		printf("\n");
+	}
+
+	int sigDepth = baselineSigDepth > 0 ? baselineSigDepth : 3;
+	unsigned long long sigNodes = benchSignature(sigDepth);
+	printf("bench %d: %llu nodes\n", sigDepth, sigNodes);
+	if(baselineSigDepth > 0 && sigNodes != baselineSigNodes)
+	{
+		printf("SIGNATURE MISMATCH: expected %llu nodes\n", baselineSigNodes);
+		failed = true;
+	}
+
+	if(save)
+	{
+		std::ofstream out(baselinePath);
+		out << "# benchmark min_ns/op" << std::endl;
+		for(const BenchResult& r : results) out << r.name << " " << r.minNs << std::endl;
+		out << "signature " << sigDepth << " " << sigNodes << std::endl;
+		printf("Saved baseline to %s\n", baselinePath);
+	}
+
+	if(failed)
+	{
+		printf("FAILED: regression against %s\n", baselinePath);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+//
+// 사용자 입력을 기다리는 동안 백그라운드 스레드에서 현재 판을 미리 분석해두는 기능.
+// 분석은 시작할 때 복제한 엔진 위에서만 하기 때문에, 실제 게임 엔진은 분석 중에 절대 바뀌지 않음.
+//
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include "chess_search.h"
+
+
+bool isSamePosition(const ChessPosition& a, const ChessPosition& b)
+{
+	return memcmp(a.board, b.board, 64) == 0 && a.movedMask == b.movedMask && a.turn == b.turn;
+}
+
+
+class BackgroundAnalysis
+{
+public:
+	BackgroundAnalysis(int maxDepth_)
+		: maxDepth(maxDepth_), stopFlag(false), hasResult(false)
+	{}
+
+	~BackgroundAnalysis()
+	{
+		this->stop();
+	}
+
+	/**
+	 * engine을 복제해서 분석을 시작함. 같은 포지션을 이미 끝까지 분석했다면 아무것도 하지 않음.
+	 */
+	void start(ChessEngine& engine)
+	{
+		this->stop();
+
+		ChessPosition position;
+		engine.getPosition(position);
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			if(!this->hasResult || !isSamePosition(position, this->position))
+			{
+				this->hasResult = false;
+				this->position = position;
+			}
+			else if(this->latest.depth >= this->maxDepth || !this->latest.hasMove) return;
+		}
+
+		this->stopFlag.store(false);
+		ChessEngine* snapshot = new ChessEngine(engine);
+		this->thread = std::thread(&BackgroundAnalysis::run, this, snapshot);
+	}
+
+	/**
+	 * 분석을 바로 멈추고 스레드가 끝날 때까지 기다림. 분석 결과는 그대로 남아있음.
+	 */
+	void stop()
+	{
+		if(!this->thread.joinable()) return;
+		this->stopFlag.store(true);
+		this->thread.join();
+		chessStats.merge(this->threadStats);
+	}
+
+	/**
+	 * engine의 현재 포지션에 대한 분석 결과가 있으면 result에 넣고 true를 리턴함.
+	 */
+	bool getHint(ChessEngine& engine, SearchResult& result)
+	{
+		ChessPosition position;
+		engine.getPosition(position);
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if(!this->hasResult || !this->latest.hasMove || !isSamePosition(position, this->position)) return false;
+		result = this->latest;
+		return true;
+	}
+
+private:
+	int maxDepth;
+	std::thread thread;
+	std::atomic<bool> stopFlag;
+	std::mutex mutex;
+	ChessPosition position;
+	SearchResult latest;
+	bool hasResult;
+	ChessStats threadStats;
+
+	void run(ChessEngine* snapshot)
+	{
+		chessStats.reset();
+
+		ChessSearch search;
+		search.onIteration = [&](const SearchResult& result) {
+			std::lock_guard<std::mutex> lock(this->mutex);
+			// 같은 포지션을 다시 분석하는 중이라면 더 깊이 본 결과만 반영함
+			if(this->hasResult && result.depth <= this->latest.depth) return;
+			this->latest = result;
+			this->hasResult = true;
+		};
+		search.search(*snapshot, { this->maxDepth, 0 }, &this->stopFlag);
+		delete snapshot;
+
+		this->threadStats = chessStats;
+	}
+};
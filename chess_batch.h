@@ -0,0 +1,378 @@
+#pragma once
+
+//
+// 서로 관계없는 수많은 포지션에 같은 질문(체크인지, 말 종류별로 둘 수 있는 칸 수, 공격하는 칸 수)을
+// 한꺼번에 계산하는 배치 API. (데이터셋 라벨링용)
+//
+// 포지션을 BATCH_BLOCK개씩 structure-of-arrays 비트보드(말 종류별로 포지션들의 비트보드가 연속)로 모은 후,
+// GCC 벡터 확장으로 포지션 여러 개를 한 레인씩 맡아서 계산함.
+//   AVX-512: 8개, AVX2: 4개, 스칼라: 1개
+// 세 커널 모두 같은 템플릿 코드를 레인 수만 바꿔서 컴파일한 것이라 결과가 항상 같음. 실행할 CPU에 맞는 커널은 실행 중에 고름.
+//
+// 결과는 엔진과 똑같이 나옴:
+//   inCheck[c]         = 포지션을 엔진에 넣었을 때의 isCheckmate(c)
+//                        (c의 킹이 여러 개면 findPiece()처럼 첫 번째 킹만 봄)
+//   mobility[c][t]     = 색깔 c, 종류 t인 말들에 대해 isPieceMovableTo(src, dst, false, false)가 true인 (src, dst) 개수
+//                        (캐슬링 포함, 자기 킹이 잡히는지는 확인하지 않음)
+//   attacked[c]        = 그 칸에 상대 말이 있다면 c의 말이 isPieceMovableTo(..., false, false)로 잡을 수 있는 칸의 개수
+//                        (자기 말이 있는 칸도 포함)
+// 엔진이 앙파상과 프로모션을 지원하지 않기 때문에 이 계산에도 없음.
+//
+
+#include <string.h>
+
+
+const int BATCH_BLOCK = 64;
+
+// 배치에서 쓰는 말 종류 순서
+enum BatchPieceType
+{
+	BATCH_PAWN, BATCH_KNIGHT, BATCH_BISHOP, BATCH_ROOK, BATCH_QUEEN, BATCH_KING,
+	BATCH_PIECE_TYPES
+};
+
+const char BATCH_PIECE_SYMBOLS[BATCH_PIECE_TYPES] = { 'P', 'N', 'B', 'R', 'Q', 'K' };
+
+// 색깔 인덱스: 0 흑, 1 백
+const int BATCH_BLACK = 0, BATCH_WHITE = 1;
+
+
+/**
+ * 포지션 BATCH_BLOCK개. 비트 y * 8 + x가 (x, y) 칸.
+ */
+struct PositionBlock
+{
+	int count;
+	alignas(64) unsigned long long pieces[2][BATCH_PIECE_TYPES][BATCH_BLOCK];
+	alignas(64) unsigned long long unmoved[BATCH_BLOCK]; // 움직인 적 없는 킹과 룩
+
+	PositionBlock()
+	{
+		this->clear();
+	}
+
+	/**
+	 * 블록을 다시 쓰기 전에 불러야 함.
+	 */
+	void clear()
+	{
+		// 빈 레인도 커널이 같이 계산하기 때문에 항상 0으로 채워둠
+		memset(this, 0, sizeof(PositionBlock));
+	}
+
+	/**
+	 * @return 블록이 꽉 차 있으면 false
+	 */
+	bool add(const ChessPosition& position)
+	{
+		if(this->count == BATCH_BLOCK) return false;
+		int lane = this->count++;
+		for(int color = 0; color < 2; color++) for(int t = 0; t < BATCH_PIECE_TYPES; t++) this->pieces[color][t][lane] = 0;
+		this->unmoved[lane] = 0;
+
+		for(int i = 0; i < 64; i++)
+		{
+			char c = position.board[i];
+			const char* symbol = (const char*) memchr(BATCH_PIECE_SYMBOLS, c & 0b01011111, BATCH_PIECE_TYPES);
+			if(c == ' ' || symbol == nullptr) continue;
+			int type = symbol - BATCH_PIECE_SYMBOLS;
+			int color = (c & 0b00100000) ? BATCH_WHITE : BATCH_BLACK;
+			this->pieces[color][type][lane] |= 1ULL << i;
+			if((type == BATCH_KING || type == BATCH_ROOK) && (position.movedMask >> i & 1) == 0) this->unmoved[lane] |= 1ULL << i;
+		}
+		return true;
+	}
+};
+
+
+struct FeatureBlock
+{
+	// 레인 폭을 맞추려고 모두 64비트
+	alignas(64) unsigned long long inCheck[2][BATCH_BLOCK];
+	alignas(64) unsigned long long mobility[2][BATCH_PIECE_TYPES][BATCH_BLOCK];
+	alignas(64) unsigned long long attacked[2][BATCH_BLOCK];
+};
+
+
+enum class BatchKernel
+{
+	SCALAR, AVX2, AVX512
+};
+
+const char* const BATCH_KERNEL_NAMES[] = { "scalar", "avx2", "avx512" };
+
+
+typedef unsigned long long BatchLane1;
+typedef unsigned long long BatchLane4 __attribute__((vector_size(32)));
+typedef unsigned long long BatchLane8 __attribute__((vector_size(64)));
+
+// 벡터 타입을 값으로 주고받는 함수는 target 속성이 없으면 ABI가 달라진다는 경고(-Wpsabi)가 나오고,
+// 이 경고는 템플릿이 번역 단위 끝에서 만들어질 때 나오기 때문에 pragma로 감쌀 수도 없음.
+// 그래서 아래 함수들은 벡터를 모두 참조로만 주고받고, 커널 안으로 모두 인라인시킴
+#define BATCH_INLINE static inline __attribute__((always_inline))
+
+// x를 d만큼 이동시킨 값. (d > 0이면 인덱스가 커지는 쪽, d는 상수)
+#define BATCH_SHIFT(x, d) ((d) > 0 ? (x) << ((d) > 0 ? (d) : 0) : (x) >> ((d) < 0 ? -(d) : 0))
+
+const unsigned long long BATCH_FILE_A = 0x0101010101010101ULL;
+const unsigned long long BATCH_FILE_H = 0x8080808080808080ULL;
+
+
+/**
+ * 한 칸 d 방향으로 이동할 때 반대쪽 끝으로 넘어가버리는 칸을 지우는 마스크.
+ * (x가 커지는 방향이면 A파일, 작아지는 방향이면 H파일로 도착한 칸을 지움)
+ */
+template<int D>
+constexpr unsigned long long batchWrapMask()
+{
+	return (D == 1 || D == 9 || D == -7 || D == 17 || D == -15) ? ~BATCH_FILE_A
+		: (D == -1 || D == -9 || D == 7 || D == -17 || D == 15) ? ~BATCH_FILE_H
+		: ~0ULL;
+}
+
+
+/**
+ * sum에 x의 레인별 비트 수를 더함.
+ */
+template<typename V>
+BATCH_INLINE void batchAddPopcount(V& sum, const V& bits)
+{
+	V x = bits;
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	x = x + (x >> 8);
+	x = x + (x >> 16);
+	x = x + (x >> 32);
+	sum += x & 0x7F;
+}
+
+// 스칼라 커널은 하드웨어 popcnt를 씀
+BATCH_INLINE void batchAddPopcount(BatchLane1& sum, const BatchLane1& bits)
+{
+	sum += __builtin_popcountll(bits);
+}
+
+
+/**
+ * gen에 있는 말들이 d 방향으로 빈 칸을 따라 미끄러져서 닿는 칸 (처음 막힌 칸 포함)을 targets에 넣음. Kogge-Stone 채우기.
+ * 같은 방향에서 한 칸에 닿는 말은 항상 하나뿐이라서, popcount가 그대로 말마다의 이동 가능 칸 수의 합이 됨.
+ */
+template<int D, typename V>
+BATCH_INLINE void batchSlide(V& targets, const V& from, const V& empty)
+{
+	const unsigned long long wrap = batchWrapMask<D>();
+	V gen = from, pro = empty & wrap;
+	gen |= pro & BATCH_SHIFT(gen, D);
+	pro &= BATCH_SHIFT(pro, D);
+	gen |= pro & BATCH_SHIFT(gen, 2 * D);
+	pro &= BATCH_SHIFT(pro, 2 * D);
+	gen |= pro & BATCH_SHIFT(gen, 4 * D);
+	targets = BATCH_SHIFT(gen, D) & wrap;
+}
+
+
+/**
+ * 한 방향의 도착 칸들을 공격 칸에 더하고, 자기 말이 없는 칸 수를 이동 가능 수에 더함.
+ */
+template<typename V>
+BATCH_INLINE void batchAddTargets(const V& targets, const V& notOwn, V& attacks, V& mobility)
+{
+	attacks |= targets;
+	batchAddPopcount(mobility, targets & notOwn);
+}
+
+
+template<int D, typename V>
+BATCH_INLINE void batchAddSlides(const V& gen, const V& empty, const V& notOwn, V& attacks, V& mobility)
+{
+	V targets;
+	batchSlide<D>(targets, gen, empty);
+	batchAddTargets(targets, notOwn, attacks, mobility);
+}
+
+
+template<int D, typename V>
+BATCH_INLINE void batchAddSteps(const V& gen, const V& notOwn, V& attacks, V& mobility)
+{
+	batchAddTargets(BATCH_SHIFT(gen, D) & batchWrapMask<D>(), notOwn, attacks, mobility);
+}
+
+
+/**
+ * 레인 [index, index + 레인 수)의 포지션들을 계산함.
+ */
+template<typename V>
+BATCH_INLINE void batchComputeLanes(const PositionBlock& in, FeatureBlock& out, int index)
+{
+	V pieces[2][BATCH_PIECE_TYPES], own[2];
+	V unmoved;
+	memcpy(&unmoved, &in.unmoved[index], sizeof(V));
+	for(int c = 0; c < 2; c++)
+	{
+		own[c] = V {};
+		for(int t = 0; t < BATCH_PIECE_TYPES; t++)
+		{
+			memcpy(&pieces[c][t], &in.pieces[c][t][index], sizeof(V));
+			own[c] |= pieces[c][t];
+		}
+	}
+	V empty = ~(own[0] | own[1]);
+
+	V attacks[2];
+	for(int c = 0; c < 2; c++)
+	{
+		V notOwn = ~own[c], enemy = own[1 - c];
+		V mobility[BATCH_PIECE_TYPES];
+		for(int t = 0; t < BATCH_PIECE_TYPES; t++) mobility[t] = V {};
+		attacks[c] = V {};
+
+		// 폰: 앞으로 한 칸(빈 칸), 처음 줄에서 두 칸(둘 다 빈 칸), 앞 대각선(상대 말이 있을 때만 이동, 공격은 항상)
+		// 백은 y가 작아지는 쪽(인덱스 -8), 흑은 커지는 쪽(+8)으로 전진함
+		V pawns = pieces[c][BATCH_PAWN];
+		V push, doublePush, captureWest, captureEast;
+		if(c == BATCH_WHITE)
+		{
+			push = BATCH_SHIFT(pawns, -8) & empty;
+			doublePush = BATCH_SHIFT(BATCH_SHIFT(pawns & 0x00FF000000000000ULL, -8) & empty, -8) & empty;
+			captureWest = BATCH_SHIFT(pawns, -9) & ~BATCH_FILE_H;
+			captureEast = BATCH_SHIFT(pawns, -7) & ~BATCH_FILE_A;
+		}
+		else
+		{
+			push = BATCH_SHIFT(pawns, 8) & empty;
+			doublePush = BATCH_SHIFT(BATCH_SHIFT(pawns & 0x000000000000FF00ULL, 8) & empty, 8) & empty;
+			captureWest = BATCH_SHIFT(pawns, 7) & ~BATCH_FILE_H;
+			captureEast = BATCH_SHIFT(pawns, 9) & ~BATCH_FILE_A;
+		}
+		attacks[c] |= captureWest | captureEast;
+		batchAddPopcount(mobility[BATCH_PAWN], push);
+		batchAddPopcount(mobility[BATCH_PAWN], doublePush);
+		batchAddPopcount(mobility[BATCH_PAWN], captureWest & enemy);
+		batchAddPopcount(mobility[BATCH_PAWN], captureEast & enemy);
+
+		V knights = pieces[c][BATCH_KNIGHT];
+		batchAddSteps<17>(knights, notOwn, attacks[c], mobility[BATCH_KNIGHT]);
+		batchAddSteps<15>(knights, notOwn, attacks[c], mobility[BATCH_KNIGHT]);
+		batchAddSteps<-15>(knights, notOwn, attacks[c], mobility[BATCH_KNIGHT]);
+		batchAddSteps<-17>(knights, notOwn, attacks[c], mobility[BATCH_KNIGHT]);
+		// 옆으로 두 칸 가는 점프는 두 파일에 걸쳐 넘어갈 수 있어서 한 칸씩 나눠서 마스크를 씌움
+		V east = BATCH_SHIFT(knights, 1) & ~BATCH_FILE_A, west = BATCH_SHIFT(knights, -1) & ~BATCH_FILE_H;
+		batchAddSteps<9>(east, notOwn, attacks[c], mobility[BATCH_KNIGHT]);
+		batchAddSteps<-7>(east, notOwn, attacks[c], mobility[BATCH_KNIGHT]);
+		batchAddSteps<7>(west, notOwn, attacks[c], mobility[BATCH_KNIGHT]);
+		batchAddSteps<-9>(west, notOwn, attacks[c], mobility[BATCH_KNIGHT]);
+
+		V bishops = pieces[c][BATCH_BISHOP], rooks = pieces[c][BATCH_ROOK], queens = pieces[c][BATCH_QUEEN];
+		batchAddSlides<9>(bishops, empty, notOwn, attacks[c], mobility[BATCH_BISHOP]);
+		batchAddSlides<7>(bishops, empty, notOwn, attacks[c], mobility[BATCH_BISHOP]);
+		batchAddSlides<-7>(bishops, empty, notOwn, attacks[c], mobility[BATCH_BISHOP]);
+		batchAddSlides<-9>(bishops, empty, notOwn, attacks[c], mobility[BATCH_BISHOP]);
+		batchAddSlides<1>(rooks, empty, notOwn, attacks[c], mobility[BATCH_ROOK]);
+		batchAddSlides<-1>(rooks, empty, notOwn, attacks[c], mobility[BATCH_ROOK]);
+		batchAddSlides<8>(rooks, empty, notOwn, attacks[c], mobility[BATCH_ROOK]);
+		batchAddSlides<-8>(rooks, empty, notOwn, attacks[c], mobility[BATCH_ROOK]);
+		batchAddSlides<9>(queens, empty, notOwn, attacks[c], mobility[BATCH_QUEEN]);
+		batchAddSlides<7>(queens, empty, notOwn, attacks[c], mobility[BATCH_QUEEN]);
+		batchAddSlides<-7>(queens, empty, notOwn, attacks[c], mobility[BATCH_QUEEN]);
+		batchAddSlides<-9>(queens, empty, notOwn, attacks[c], mobility[BATCH_QUEEN]);
+		batchAddSlides<1>(queens, empty, notOwn, attacks[c], mobility[BATCH_QUEEN]);
+		batchAddSlides<-1>(queens, empty, notOwn, attacks[c], mobility[BATCH_QUEEN]);
+		batchAddSlides<8>(queens, empty, notOwn, attacks[c], mobility[BATCH_QUEEN]);
+		batchAddSlides<-8>(queens, empty, notOwn, attacks[c], mobility[BATCH_QUEEN]);
+
+		V kings = pieces[c][BATCH_KING];
+		batchAddSteps<1>(kings, notOwn, attacks[c], mobility[BATCH_KING]);
+		batchAddSteps<-1>(kings, notOwn, attacks[c], mobility[BATCH_KING]);
+		batchAddSteps<8>(kings, notOwn, attacks[c], mobility[BATCH_KING]);
+		batchAddSteps<-8>(kings, notOwn, attacks[c], mobility[BATCH_KING]);
+		batchAddSteps<9>(kings, notOwn, attacks[c], mobility[BATCH_KING]);
+		batchAddSteps<7>(kings, notOwn, attacks[c], mobility[BATCH_KING]);
+		batchAddSteps<-7>(kings, notOwn, attacks[c], mobility[BATCH_KING]);
+		batchAddSteps<-9>(kings, notOwn, attacks[c], mobility[BATCH_KING]);
+
+		// 캐슬링 (KingPiece::getCastlingVictim과 같은 조건):
+		// 움직인 적 없는 킹과 같은 줄의 H/A파일에 움직인 적 없는 자기 룩이 있고 사이가 비어있으면 G/C파일로 감.
+		// 룩에서 킹 쪽으로 미끄러져서 처음 닿는 말이 그 킹인지로 확인함.
+		// 킹이 F, G(또는 B, C, D)파일에 있으면 제자리이거나 이미 센 한 칸 이동이므로 제외함.
+		V castleKings = kings & unmoved, castleRooks = rooks & unmoved;
+		V kingSide, queenSide;
+		batchSlide<-1>(kingSide, castleRooks & BATCH_FILE_H, empty);
+		batchSlide<1>(queenSide, castleRooks & BATCH_FILE_A, empty);
+		batchAddPopcount(mobility[BATCH_KING], kingSide & castleKings & ~(BATCH_FILE_H >> 1 | BATCH_FILE_H >> 2));
+		batchAddPopcount(mobility[BATCH_KING], queenSide & castleKings & 0xF0F0F0F0F0F0F0F0ULL);
+
+		for(int t = 0; t < BATCH_PIECE_TYPES; t++) memcpy(&out.mobility[c][t][index], &mobility[t], sizeof(V));
+		V attackedCount = V {};
+		batchAddPopcount(attackedCount, attacks[c]);
+		memcpy(&out.attacked[c][index], &attackedCount, sizeof(V));
+	}
+
+	// 체크: 첫 번째 킹(인덱스가 가장 작은 킹)이 상대 공격 칸에 있는지
+	for(int c = 0; c < 2; c++)
+	{
+		V kings = pieces[c][BATCH_KING];
+		V firstKing = kings & (0 - kings);
+		// 0이 아니면 1 (스칼라와 벡터 모두 같은 식으로 됨)
+		V inCheck = (V) ((firstKing & attacks[1 - c]) != 0) & 1;
+		memcpy(&out.inCheck[c][index], &inCheck, sizeof(V));
+	}
+}
+
+
+void computeFeaturesScalar(const PositionBlock& in, FeatureBlock& out)
+{
+	for(int i = 0; i < in.count; i++) batchComputeLanes<BatchLane1>(in, out, i);
+}
+
+
+__attribute__((target("avx2")))
+void computeFeaturesAvx2(const PositionBlock& in, FeatureBlock& out)
+{
+	for(int i = 0; i < in.count; i += 4) batchComputeLanes<BatchLane4>(in, out, i);
+}
+
+
+__attribute__((target("avx512f")))
+void computeFeaturesAvx512(const PositionBlock& in, FeatureBlock& out)
+{
+	for(int i = 0; i < in.count; i += 8) batchComputeLanes<BatchLane8>(in, out, i);
+}
+
+
+/**
+ * 이 CPU에서 돌릴 수 있는 가장 빠른 커널
+ */
+BatchKernel bestBatchKernel()
+{
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f")) return BatchKernel::AVX512;
+	if(__builtin_cpu_supports("avx2")) return BatchKernel::AVX2;
+	return BatchKernel::SCALAR;
+}
+
+
+bool isBatchKernelSupported(BatchKernel kernel)
+{
+	__builtin_cpu_init();
+	switch(kernel)
+	{
+		case BatchKernel::AVX512: return __builtin_cpu_supports("avx512f");
+		case BatchKernel::AVX2:   return __builtin_cpu_supports("avx2");
+		default:                  return true;
+	}
+}
+
+
+/**
+ * in의 포지션 in.count개에 대한 특징을 out에 계산함. out에서 in.count 이후 레인의 값은 의미 없음.
+ */
+void computeFeatures(const PositionBlock& in, FeatureBlock& out, BatchKernel kernel)
+{
+	switch(kernel)
+	{
+		case BatchKernel::AVX512: computeFeaturesAvx512(in, out); break;
+		case BatchKernel::AVX2:   computeFeaturesAvx2(in, out);   break;
+		default:                  computeFeaturesScalar(in, out); break;
+	}
+}
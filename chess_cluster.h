@@ -0,0 +1,637 @@
+#pragma once
+
+//
+// 여러 프로세스(또는 여러 컴퓨터)에 포지션 분석을 나눠주는 코디네이터/워커.
+//
+// 코디네이터가 TCP나 유닉스 소켓으로 기다리고, 워커 프로세스들이 접속해서 포지션을 받아 탐색한 후 결과를 돌려줌.
+// 워커는 스레드마다 엔진과 탐색기를 따로 갖고 여러 포지션을 동시에 탐색함.
+//
+// 프로토콜은 줄 단위 텍스트:
+//   워커 -> 코디네이터
+//     HELLO <슬롯 수> <heartbeatMs>                    접속하자마자 한 번. 슬롯 수는 워커의 탐색 스레드 수
+//     RESULT <id> <수(SAN), 없으면 -> <점수> <깊이> <노드 수> <ms>
+//   코디네이터 -> 워커
+//     HEARTBEAT <heartbeatMs>                          HELLO를 받으면 한 번. 코디네이터의 PING 간격
+//     JOB <id> <최대 깊이> <최대 ms> <FEN>
+//     BYE                                              모든 포지션이 끝났음. 워커는 접속을 끊고 끝냄
+//   양쪽
+//     PING                                             heartbeatMs 동안 보낸 게 없으면 보냄
+//
+// 워커마다 결과를 기다리지 않고 (슬롯 수 * pipeline)개까지 미리 보내두기 때문에, 결과가 오가는 동안에도 스레드가 쉬지 않음.
+// 양쪽의 PING 간격이 다를 수 있으므로, 둘 중 긴 간격 * HEARTBEAT_TIMEOUT 동안 상대에게서 아무 줄도 못 받거나
+// 접속이 끊기면 죽은 것으로 보고,
+// 코디네이터는 그 워커가 들고 있던 포지션을 큐 맨 앞에 다시 넣어서 다른 워커에게 줌.
+// 같은 포지션의 결과가 두 번 오면 먼저 온 것만 씀.
+//
+// 주소 형식: "unix:/tmp/chess.sock", "tcp:127.0.0.1:9000" 또는 "127.0.0.1:9000"
+//
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// 이 횟수만큼의 heartbeat 동안 아무것도 못 받으면 상대가 죽은 것으로 봄
+const int HEARTBEAT_TIMEOUT = 5;
+
+
+/**
+ * addressText에 맞는 소켓을 만들고 주소를 address에 넣음.
+ * @return 형식이 맞지 않거나 호스트를 찾을 수 없으면 -1
+ */
+int createClusterSocket(const std::string& addressText, sockaddr_storage& address, socklen_t& length)
+{
+	memset(&address, 0, sizeof(address));
+	if(addressText.compare(0, 5, "unix:") == 0)
+	{
+		std::string path = addressText.substr(5);
+		sockaddr_un* un = (sockaddr_un*) &address;
+		if(path.empty() || path.size() >= sizeof(un->sun_path)) return -1;
+		un->sun_family = AF_UNIX;
+		memcpy(un->sun_path, path.c_str(), path.size() + 1);
+		length = sizeof(sockaddr_un);
+		return socket(AF_UNIX, SOCK_STREAM, 0);
+	}
+
+	std::string hostPort = addressText.compare(0, 4, "tcp:") == 0 ? addressText.substr(4) : addressText;
+	size_t colon = hostPort.rfind(':');
+	if(colon == std::string::npos) return -1;
+	std::string host = hostPort.substr(0, colon), port = hostPort.substr(colon + 1);
+
+	addrinfo hints, *found;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	if(getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found) != 0) return -1;
+	memcpy(&address, found->ai_addr, found->ai_addrlen);
+	length = found->ai_addrlen;
+	freeaddrinfo(found);
+	return socket(AF_INET, SOCK_STREAM, 0);
+}
+
+
+/**
+ * @return 실패하면 -1
+ */
+int listenCluster(const std::string& addressText)
+{
+	sockaddr_storage address;
+	socklen_t length;
+	int fd = createClusterSocket(addressText, address, length);
+	if(fd < 0) return -1;
+
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	// 전에 쓰던 유닉스 소켓 파일이 남아있으면 bind가 실패하므로 지움
+	if(address.ss_family == AF_UNIX) unlink(((sockaddr_un*) &address)->sun_path);
+	if(bind(fd, (sockaddr*) &address, length) != 0 || listen(fd, 64) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+
+/**
+ * @param retryMs 코디네이터가 아직 안 떠 있을 수 있어서 이 시간 동안 다시 시도함
+ * @return 실패하면 -1
+ */
+int connectCluster(const std::string& addressText, int retryMs)
+{
+	auto start = std::chrono::steady_clock::now();
+	while(true)
+	{
+		sockaddr_storage address;
+		socklen_t length;
+		int fd = createClusterSocket(addressText, address, length);
+		if(fd < 0) return -1;
+		if(connect(fd, (sockaddr*) &address, length) == 0)
+		{
+			if(address.ss_family == AF_INET)
+			{
+				// 짧은 줄을 바로바로 주고받기 때문에 Nagle 알고리즘을 끔
+				int on = 1;
+				setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+			}
+			return fd;
+		}
+		close(fd);
+		if(std::chrono::steady_clock::now() - start > std::chrono::milliseconds(retryMs)) return -1;
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+}
+
+
+/**
+ * 소켓 위에서 줄 단위로 주고받는 연결. 보낼 줄은 버퍼에 모았다가 flush()에서 보냄.
+ */
+class ClusterConnection
+{
+public:
+	int fd;
+	std::chrono::steady_clock::time_point lastReceived, lastSent;
+
+	ClusterConnection(int fd_)
+		: fd(fd_), lastReceived(std::chrono::steady_clock::now()), lastSent(lastReceived)
+	{}
+
+	/**
+	 * 소켓에서 한 번 읽어서 버퍼에 붙임. (poll로 읽을 게 있다고 확인한 후에 부름)
+	 * @return 접속이 끊겼으면 false
+	 */
+	bool receive()
+	{
+		char buffer[65536];
+		ssize_t n = recv(this->fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+		if(n == 0) return false;
+		if(n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		this->input.append(buffer, n);
+		this->lastReceived = std::chrono::steady_clock::now();
+		return true;
+	}
+
+	/**
+	 * @return 받은 줄이 더 없으면 false
+	 */
+	bool nextLine(std::string& line)
+	{
+		size_t end = this->input.find('\n', this->inputStart);
+		if(end == std::string::npos)
+		{
+			// 다 읽은 부분은 가끔씩만 지움
+			this->input.erase(0, this->inputStart);
+			this->inputStart = 0;
+			return false;
+		}
+		line.assign(this->input, this->inputStart, end - this->inputStart);
+		if(!line.empty() && line.back() == '\r') line.pop_back();
+		this->inputStart = end + 1;
+		return true;
+	}
+
+	void send(const std::string& line)
+	{
+		this->output += line;
+		this->output += '\n';
+	}
+
+	/**
+	 * 버퍼에 모인 줄을 보냄.
+	 * @param block true면 다 보낼 때까지 기다림. false면 소켓 버퍼가 찰 때까지만 보냄
+	 * @return 접속이 끊겼으면 false
+	 */
+	bool flush(bool block)
+	{
+		size_t sent = 0;
+		while(sent < this->output.size())
+		{
+			ssize_t n = ::send(this->fd, this->output.data() + sent, this->output.size() - sent,
+				MSG_NOSIGNAL | (block ? 0 : MSG_DONTWAIT));
+			if(n < 0)
+			{
+				if(errno == EINTR) continue;
+				if(!block && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+				return false;
+			}
+			sent += n;
+		}
+		if(sent > 0) this->lastSent = std::chrono::steady_clock::now();
+		this->output.erase(0, sent);
+		return true;
+	}
+
+	bool hasOutput() const { return !this->output.empty(); }
+
+private:
+	std::string input, output;
+	size_t inputStart = 0;
+};
+
+
+struct ClusterJob
+{
+	int id;
+	std::string fen;
+};
+
+
+struct ClusterResult
+{
+	int id;
+	int workerId;
+	std::string move; // SAN. 둘 수 있는 수가 없으면 "-"
+	int score, depth;
+	unsigned long long nodes;
+	double ms;
+};
+
+
+struct ClusterSettings
+{
+	SearchLimits limits;
+	int pipeline;    // 워커의 슬롯 하나당 미리 보내둘 포지션 수
+	int heartbeatMs;
+	int idleTimeoutMs; // 접속한 워커가 하나도 없는 채로 이만큼 지나면 끝냄 (0이면 계속 기다림)
+};
+
+
+/**
+ * 포지션들을 접속한 워커들에게 나눠주고 결과를 모으는 코디네이터. 한 스레드에서 poll로 모든 연결을 처리함.
+ */
+class ClusterCoordinator
+{
+public:
+	/**
+	 * 결과가 하나 도착할 때마다 도착한 순서대로 불림.
+	 */
+	std::function<void(const ClusterResult&)> onResult;
+	/**
+	 * 워커가 접속하거나 끊겼을 때 불림. (로그용)
+	 */
+	std::function<void(const std::string&)> onEvent;
+	/**
+	 * 접속한 워커가 하나도 없을 때 불림. false를 돌려주면 더 기다리지 않고 끝냄. (올 워커가 없는지 아는 경우, 없으면 계속 기다림)
+	 */
+	std::function<bool()> keepWaiting;
+
+	ClusterCoordinator(const ClusterSettings& settings_, const std::vector<ClusterJob>& jobs_)
+		: settings(settings_), jobs(jobs_), doneCount(0), requeueCount(0)
+	{}
+
+	/**
+	 * listenFd로 들어오는 워커들에게 모든 포지션을 나눠주고, 결과가 다 모이면 워커들에게 BYE를 보내고 끝냄.
+	 * @return 워커가 없어서 결과를 다 모으지 못하고 끝났으면 false
+	 */
+	bool run(int listenFd)
+	{
+		this->done.assign(this->jobs.size(), false);
+		for(size_t i = 0; i < this->jobs.size(); i++) this->pending.push_back(i);
+
+		std::vector<pollfd> fds;
+		std::string line;
+		bool waiting = false;
+		auto idleSince = std::chrono::steady_clock::now();
+		while(this->doneCount < this->jobs.size())
+		{
+			if(this->workers.empty())
+			{
+				auto now = std::chrono::steady_clock::now();
+				if(!waiting)
+				{
+					waiting = true;
+					idleSince = now;
+					this->event("waiting for workers, " + std::to_string(this->jobs.size() - this->doneCount) + " position(s) left");
+				}
+				if(this->keepWaiting && !this->keepWaiting())
+				{
+					this->event("no workers left");
+					break;
+				}
+				if(this->settings.idleTimeoutMs > 0 && now - idleSince > std::chrono::milliseconds(this->settings.idleTimeoutMs))
+				{
+					this->event("no workers for " + std::to_string(this->settings.idleTimeoutMs) + " ms, giving up");
+					break;
+				}
+			}
+			else waiting = false;
+
+			fds.clear();
+			fds.push_back({ listenFd, POLLIN, 0 });
+			for(Worker& worker : this->workers)
+			{
+				fds.push_back({ worker.connection.fd, (short) (POLLIN | (worker.connection.hasOutput() ? POLLOUT : 0)), 0 });
+			}
+			poll(fds.data(), fds.size(), this->settings.heartbeatMs / 2);
+
+			if(fds[0].revents & POLLIN) this->accept(listenFd);
+			for(size_t i = 1; i < fds.size(); i++)
+			{
+				Worker& worker = this->workers[i - 1];
+				if(fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+				{
+					if(!worker.connection.receive()) worker.alive = false;
+					while(worker.alive && worker.connection.nextLine(line)) this->handleLine(worker, line);
+				}
+			}
+
+			auto now = std::chrono::steady_clock::now();
+			auto heartbeat = std::chrono::milliseconds(this->settings.heartbeatMs);
+			for(Worker& worker : this->workers)
+			{
+				auto timeout = std::chrono::milliseconds(std::max(this->settings.heartbeatMs, worker.heartbeatMs)) * HEARTBEAT_TIMEOUT;
+				if(now - worker.connection.lastReceived > timeout) worker.alive = false;
+				if(!worker.alive) continue;
+				this->assign(worker);
+				if(!worker.connection.hasOutput() && now - worker.connection.lastSent > heartbeat) worker.connection.send("PING");
+				if(!worker.connection.flush(false)) worker.alive = false;
+			}
+			this->removeDeadWorkers();
+		}
+
+		for(Worker& worker : this->workers)
+		{
+			worker.connection.send("BYE");
+			worker.connection.flush(true);
+			close(worker.connection.fd);
+		}
+		this->workers.clear();
+		return this->doneCount == this->jobs.size();
+	}
+
+	size_t getDoneCount() const { return this->doneCount; }
+
+	size_t getRequeueCount() const { return this->requeueCount; }
+
+	/**
+	 * 워커 id -> 그 워커가 보낸 결과 수
+	 */
+	const std::vector<size_t>& getResultCounts() const { return this->resultCounts; }
+
+private:
+	struct Worker
+	{
+		int id;
+		ClusterConnection connection;
+		int slots;                  // HELLO를 받기 전에는 0
+		int heartbeatMs;            // 워커의 PING 간격. HELLO를 받기 전에는 코디네이터의 간격
+		std::vector<int> inFlight;  // 보냈지만 결과를 못 받은 포지션
+		bool alive;
+	};
+
+	ClusterSettings settings;
+	std::vector<ClusterJob> jobs;
+	std::vector<bool> done;
+	std::deque<int> pending;
+	std::vector<Worker> workers;
+	std::vector<size_t> resultCounts;
+	size_t doneCount, requeueCount;
+
+	void event(const std::string& text)
+	{
+		if(this->onEvent) this->onEvent(text);
+	}
+
+	void accept(int listenFd)
+	{
+		int fd = ::accept(listenFd, nullptr, nullptr);
+		if(fd < 0) return;
+		int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // 유닉스 소켓이면 그냥 실패함
+		int id = this->resultCounts.size();
+		this->resultCounts.push_back(0);
+		this->workers.push_back({ id, ClusterConnection(fd), 0, this->settings.heartbeatMs, {}, true });
+	}
+
+	void handleLine(Worker& worker, const std::string& line)
+	{
+		std::istringstream in(line);
+		std::string command;
+		in >> command;
+		if(command == "HELLO")
+		{
+			in >> worker.slots;
+			if(worker.slots < 1) worker.slots = 1;
+			// 간격을 안 보내는 워커는 코디네이터와 같은 간격으로 봄
+			if(!(in >> worker.heartbeatMs) || worker.heartbeatMs < 1) worker.heartbeatMs = this->settings.heartbeatMs;
+			worker.connection.send("HEARTBEAT " + std::to_string(this->settings.heartbeatMs));
+			this->event("worker " + std::to_string(worker.id) + " connected with " + std::to_string(worker.slots) + " slot(s)");
+		}
+		else if(command == "RESULT")
+		{
+			ClusterResult result;
+			result.workerId = worker.id;
+			if(!(in >> result.id >> result.move >> result.score >> result.depth >> result.nodes >> result.ms)
+				|| result.id < 0 || result.id >= (int) this->jobs.size())
+			{
+				worker.alive = false;
+				this->event("worker " + std::to_string(worker.id) + " sent an invalid line: " + line);
+				return;
+			}
+			for(size_t i = 0; i < worker.inFlight.size(); i++)
+			{
+				if(worker.inFlight[i] != result.id) continue;
+				worker.inFlight.erase(worker.inFlight.begin() + i);
+				break;
+			}
+			if(this->done[result.id]) return;
+			this->done[result.id] = true;
+			this->doneCount++;
+			this->resultCounts[worker.id]++;
+			if(this->onResult) this->onResult(result);
+		}
+		else if(command != "PING")
+		{
+			worker.alive = false;
+			this->event("worker " + std::to_string(worker.id) + " sent an unknown command: " + line);
+		}
+	}
+
+	/**
+	 * 워커가 (슬롯 수 * pipeline)개를 들고 있도록 포지션을 보냄
+	 */
+	void assign(Worker& worker)
+	{
+		size_t limit = worker.slots * this->settings.pipeline;
+		while(worker.inFlight.size() < limit && !this->pending.empty())
+		{
+			int id = this->pending.front();
+			this->pending.pop_front();
+			// 다시 넣은 포지션의 결과가 그 사이에 도착했을 수 있음
+			if(this->done[id]) continue;
+			worker.inFlight.push_back(id);
+			worker.connection.send("JOB " + std::to_string(id) + " " + std::to_string(this->settings.limits.maxDepth) + " "
+				+ std::to_string(this->settings.limits.maxTimeMs) + " " + this->jobs[id].fen);
+		}
+	}
+
+	/**
+	 * 죽은 워커의 포지션을 큐 맨 앞에 다시 넣고 연결을 닫음
+	 */
+	void removeDeadWorkers()
+	{
+		for(size_t i = 0; i < this->workers.size(); )
+		{
+			Worker& worker = this->workers[i];
+			if(worker.alive)
+			{
+				i++;
+				continue;
+			}
+			for(auto it = worker.inFlight.rbegin(); it != worker.inFlight.rend(); ++it)
+			{
+				if(this->done[*it]) continue;
+				this->pending.push_front(*it);
+				this->requeueCount++;
+			}
+			this->event("worker " + std::to_string(worker.id) + " disconnected, " + std::to_string(worker.inFlight.size())
+				+ " position(s) requeued");
+			close(worker.connection.fd);
+			this->workers.erase(this->workers.begin() + i);
+		}
+	}
+};
+
+
+/**
+ * 코디네이터에 접속해서 받은 포지션을 여러 스레드로 탐색하는 워커.
+ */
+class ClusterWorker
+{
+public:
+	/**
+	 * 결과를 이만큼 보낸 후 바로 프로세스를 끝냄. (워커가 죽었을 때 다시 나눠주는지 확인하는 용도, 0이면 끔)
+	 */
+	int failAfter;
+
+	ClusterWorker(int threadCount_, int heartbeatMs_)
+		: failAfter(0), threadCount(threadCount_ < 1 ? 1 : threadCount_), heartbeatMs(heartbeatMs_), connection(-1),
+		stopFlag(false), sentResults(0)
+	{}
+
+	/**
+	 * fd로 코디네이터와 주고받으면서 BYE를 받거나 접속이 끊길 때까지 돌림.
+	 * @return BYE를 받고 끝났으면 true
+	 */
+	bool run(int fd)
+	{
+		this->connection = ClusterConnection(fd);
+		this->stopFlag = false;
+		this->send("HELLO " + std::to_string(this->threadCount) + " " + std::to_string(this->heartbeatMs));
+
+		std::vector<std::thread> threads;
+		for(int t = 0; t < this->threadCount; t++) threads.emplace_back(&ClusterWorker::work, this);
+
+		bool finished = false;
+		std::string line;
+		auto heartbeat = std::chrono::milliseconds(this->heartbeatMs);
+		// HEARTBEAT를 받기 전에는 코디네이터도 같은 간격이라고 봄
+		auto timeout = heartbeat * HEARTBEAT_TIMEOUT;
+		while(!finished && !this->stopFlag)
+		{
+			pollfd pfd = { fd, POLLIN, 0 };
+			poll(&pfd, 1, this->heartbeatMs / 2);
+			if(pfd.revents & (POLLIN | POLLHUP | POLLERR))
+			{
+				if(!this->connection.receive()) break;
+				while(this->connection.nextLine(line))
+				{
+					if(line.compare(0, 4, "JOB ") == 0) this->push(line);
+					else if(line == "BYE") finished = true;
+					else if(line.compare(0, 10, "HEARTBEAT ") == 0)
+					{
+						int peerMs = atoi(line.c_str() + 10);
+						timeout = std::chrono::milliseconds(std::max(this->heartbeatMs, peerMs)) * HEARTBEAT_TIMEOUT;
+					}
+				}
+			}
+
+			auto now = std::chrono::steady_clock::now();
+			if(now - this->connection.lastReceived > timeout) break;
+			std::lock_guard<std::mutex> lock(this->sendMutex);
+			if(now - this->connection.lastSent > heartbeat)
+			{
+				this->connection.send("PING");
+				if(!this->connection.flush(true)) break;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(this->queueMutex);
+			this->stopFlag = true;
+		}
+		this->wakeUp.notify_all();
+		for(std::thread& thread : threads) thread.join();
+		close(fd);
+		return finished;
+	}
+
+private:
+	int threadCount, heartbeatMs;
+	ClusterConnection connection;
+
+	std::mutex queueMutex;
+	std::condition_variable wakeUp;
+	std::deque<std::string> queue; // 받은 JOB 줄
+	std::atomic<bool> stopFlag;
+
+	std::mutex sendMutex;
+	int sentResults;
+
+	void push(const std::string& line)
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->queueMutex);
+			this->queue.push_back(line);
+		}
+		this->wakeUp.notify_one();
+	}
+
+	void send(const std::string& line)
+	{
+		std::lock_guard<std::mutex> lock(this->sendMutex);
+		this->connection.send(line);
+		if(!this->connection.flush(true)) this->stopFlag = true;
+	}
+
+	void work()
+	{
+		ChessEngine engine;
+		engine.setPhysicalEnabled(false);
+		ChessSearch search;
+		while(true)
+		{
+			std::string line;
+			{
+				std::unique_lock<std::mutex> lock(this->queueMutex);
+				this->wakeUp.wait(lock, [&]() { return this->stopFlag || !this->queue.empty(); });
+				if(this->stopFlag) return;
+				line = this->queue.front();
+				this->queue.pop_front();
+			}
+
+			// JOB <id> <깊이> <ms> <FEN>
+			int id, maxDepth, maxTimeMs, offset = 0;
+			ChessPosition position;
+			if(sscanf(line.c_str(), "JOB %d %d %d %n", &id, &maxDepth, &maxTimeMs, &offset) != 3
+				|| !parseFen(line.c_str() + offset, position))
+			{
+				continue;
+			}
+			engine.setPosition(position);
+			SearchResult result = search.search(engine, { maxDepth, maxTimeMs }, &this->stopFlag);
+			if(this->stopFlag) return;
+
+			char text[128];
+			snprintf(text, sizeof(text), "RESULT %d %s %d %d %llu %.1f", id,
+				result.hasMove ? formatSan(engine, result.bestMove).c_str() : "-",
+				result.score, result.depth, result.nodes, result.ms);
+
+			std::lock_guard<std::mutex> lock(this->sendMutex);
+			this->connection.send(text);
+			if(!this->connection.flush(true)) this->stopFlag = true;
+			if(this->failAfter > 0 && ++this->sentResults >= this->failAfter) _exit(3);
+		}
+	}
+};
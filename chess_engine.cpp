@@ -8,33 +8,40 @@ public:
 		: ChessPiece(x, y, PieceType::PAWN, color)
 	{}
 
-	bool isMovableTo(ChessEngine &engine, int dstX, int dstY)
+	ChessPiece* clone()
 	{
-		PathState pathState = engine.checkPath(this->x, this->y, dstX, dstY);
+		return new PawnPiece(this->x, this->y, this->color);
+	}
+
+	/**
+	 * 색깔이 C인 폰이 (x, y)에서 (dstX, dstY)로 갈 수 있는지. 전진 방향과 처음 줄은 컴파일 타임에 정해짐.
+	 */
+	template<PieceColor C>
+	static bool isMovableTo(ChessEngine &engine, int x, int y, int dstX, int dstY)
+	{
+		typedef ColorTraits<C> Traits;
 		ChessPiece* dstPiece = engine.getPieceAt(dstX, dstY);
-		
-		if((this->color == PieceColor::BLACK && this->y == 1 && dstY == 3) ||
-		   (this->color == PieceColor::WHITE && this->y == 6 && dstY == 4)) // 2칸 앞 이동
+
+		if(y == Traits::pawnHomeRank && dstY == Traits::pawnDoubleRank) // 2칸 앞 이동
 		{
-			return pathState == PathState::STRAIGHT_LINE && dstPiece == nullptr;
+			return dstX == x && dstPiece == nullptr && engine.checkPath(x, y, dstX, dstY) == PathState::STRAIGHT_LINE;
 		}
 
-		if((this->color == PieceColor::BLACK && dstY - this->y == 1) ||
-		   (this->color == PieceColor::WHITE && dstY - this->y == -1)) // 1칸 앞/대각선 이동
+		if(dstY - y == Traits::forward) // 1칸 앞/대각선 이동
 		{
-			switch(pathState)
-			{
-				case PathState::STRAIGHT_LINE: // 1칸 앞 이동
-					return dstPiece == nullptr;
-
-				case PathState::DIAGONAL: // 1칸 대각선 이동
-					return dstPiece != nullptr && this->color != dstPiece->color;
-			}
+			if(dstX == x) return dstPiece == nullptr;
+			if(abs(dstX - x) == 1) return dstPiece != nullptr && dstPiece->color != C;
 		}
 
 		return false;
 	}
 
+	bool isMovableTo(ChessEngine &engine, int dstX, int dstY)
+	{
+		if(this->color == PieceColor::WHITE) return isMovableTo<PieceColor::WHITE>(engine, this->x, this->y, dstX, dstY);
+		return isMovableTo<PieceColor::BLACK>(engine, this->x, this->y, dstX, dstY);
+	}
+
 	void whenMoved(ChessEngine &engine, int dstX, int dstY) override
 	{
 		// TODO: 폰이 끝에 도달했을 때도 구현할 것
@@ -52,6 +59,13 @@ public:
 		: ChessPiece(x, y, PieceType::ROOK, color), didMove(false)
 	{}
 
+	ChessPiece* clone()
+	{
+		RookPiece* piece = new RookPiece(this->x, this->y, this->color);
+		piece->didMove = this->didMove;
+		return piece;
+	}
+
 	bool isMovableTo(ChessEngine &engine, int dstX, int dstY)
 	{
 		return engine.checkPath(this->x, this->y, dstX, dstY) == PathState::STRAIGHT_LINE;
@@ -71,6 +85,11 @@ public:
 		: ChessPiece(x, y, PieceType::KNIGHT, color)
 	{}
 
+	ChessPiece* clone()
+	{
+		return new KnightPiece(this->x, this->y, this->color);
+	}
+
 	bool isMovableTo(ChessEngine &engine, int dstX, int dstY)
 	{
 		if(abs(this->x - dstX) + abs(this->y - dstY) != 3) return false;
@@ -87,6 +106,11 @@ public:
 		: ChessPiece(x, y, PieceType::BISHOP, color)
 	{}
 
+	ChessPiece* clone()
+	{
+		return new BishopPiece(this->x, this->y, this->color);
+	}
+
 	bool isMovableTo(ChessEngine &engine, int dstX, int dstY)
 	{
 		return engine.checkPath(this->x, this->y, dstX, dstY) == PathState::DIAGONAL;
@@ -101,6 +125,11 @@ public:
 		: ChessPiece(x, y, PieceType::QUEEN, color)
 	{}
 
+	ChessPiece* clone()
+	{
+		return new QueenPiece(this->x, this->y, this->color);
+	}
+
 	bool isMovableTo(ChessEngine &engine, int dstX, int dstY)
 	{
 		PathState pathState = engine.checkPath(this->x, this->y, dstX, dstY);
@@ -118,6 +147,13 @@ public:
 		: ChessPiece(x, y, PieceType::KING, color), didMove(false)
 	{}
 
+	ChessPiece* clone()
+	{
+		KingPiece* piece = new KingPiece(this->x, this->y, this->color);
+		piece->didMove = this->didMove;
+		return piece;
+	}
+
 	bool isMovableTo(ChessEngine &engine, int dstX, int dstY)
 	{
 		// 일반 킹 이동 여부
@@ -180,6 +216,77 @@ public:
 };
 
 
+/**
+ * 킹과 룩의 didMove를 읽는 함수. 다른 말은 항상 false
+ */
+bool getDidMove(ChessPiece* piece)
+{
+	if(piece->type == PieceType::KING) return static_cast<KingPiece*>(piece)->didMove;
+	if(piece->type == PieceType::ROOK) return static_cast<RookPiece*>(piece)->didMove;
+	return false;
+}
+
+
+void setDidMove(ChessPiece* piece, bool didMove)
+{
+	if(piece->type == PieceType::KING) static_cast<KingPiece*>(piece)->didMove = didMove;
+	if(piece->type == PieceType::ROOK) static_cast<RookPiece*>(piece)->didMove = didMove;
+}
+
+
+/**
+ * 말의 4비트 코드. 3번 비트는 백, 하위 3비트는 말 종류
+ * (킹과 룩은 캐슬링 가능 여부가 해시에 들어가도록 움직였는지에 따라 코드가 다름)
+ */
+int pieceCode(ChessPiece* piece)
+{
+	int code;
+	switch(piece->type)
+	{
+		case PieceType::PAWN:   code = 1; break;
+		case PieceType::KNIGHT: code = 2; break;
+		case PieceType::BISHOP: code = 3; break;
+		case PieceType::ROOK:   code = getDidMove(piece) ? 4 : 7; break;
+		case PieceType::QUEEN:  code = 5; break;
+		default:                code = getDidMove(piece) ? 6 : 0; break;
+	}
+	return piece->color == PieceColor::WHITE ? code | 8 : code;
+}
+
+
+/**
+ * 포지션 해시(조브리스트 해시)에 쓰는 난수표. 항상 같은 값이 나오도록 고정된 시드로 만듦.
+ */
+struct ZobristKeys
+{
+	unsigned long long piece[16][64];
+	unsigned long long whiteTurn;
+
+	ZobristKeys()
+	{
+		unsigned long long state = 0x9E3779B97F4A7C15ULL;
+		for(int c = 0; c < 16; c++) for(int i = 0; i < 64; i++) this->piece[c][i] = next(state);
+		this->whiteTurn = next(state);
+	}
+
+	// splitmix64
+	static unsigned long long next(unsigned long long& state)
+	{
+		unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	unsigned long long of(ChessPiece* piece)
+	{
+		return this->piece[pieceCode(piece)][piece->y * 8 + piece->x];
+	}
+};
+
+ZobristKeys ZOBRIST;
+
+
 ChessPiece::ChessPiece(int x_, int y_, PieceType type_, PieceColor color_)
 	: x(x_), y(y_), type(type_), color(color_)
 {}
@@ -191,13 +298,73 @@ ChessPiece::~ChessPiece()
 
 ChessEngine::ChessEngine()
 {
+	// resetBoard()가 clearBoard()로 기존 말들을 delete하기 때문에 먼저 비워둬야 함
+	for(int y = 0; y < 8; y++) for(int x = 0; x < 8; x++)
+	{
+		this->chessBoard[y][x] = nullptr;
+	}
+	this->physicalBoard = nullptr;
+	this->physicalEnabled = true;
+	this->historySize = 0;
 	this->resetBoard();
 }
 
 
+ChessEngine::ChessEngine(const ChessEngine& other)
+{
+	for(int y = 0; y < 8; y++) for(int x = 0; x < 8; x++)
+	{
+		this->chessBoard[y][x] = nullptr;
+	}
+	// 복제된 엔진(시뮬레이션용)은 실제 체스판을 움직이면 안 됨
+	this->physicalBoard = nullptr;
+	this->physicalEnabled = false;
+	this->historySize = 0;
+	this->copyFrom(other);
+}
+
+
 ChessEngine::~ChessEngine()
 {
 	this->clearBoard();
+	this->clearHistory();
+}
+
+
+ChessEngine& ChessEngine::operator=(const ChessEngine& other)
+{
+	if(this != &other) this->copyFrom(other);
+	return *this;
+}
+
+
+/**
+ * other의 판을 말 하나하나까지 복제해서 가져오는 함수.
+ * 복제된 엔진은 other와 말을 공유하지 않기 때문에 서로 영향을 주지 않음.
+ */
+void ChessEngine::copyFrom(const ChessEngine& other)
+{
+	this->clearBoard();
+	for(int y = 0; y < 8; y++) for(int x = 0; x < 8; x++)
+	{
+		ChessPiece* piece = other.chessBoard[y][x];
+		this->chessBoard[y][x] = piece == nullptr ? nullptr : piece->clone();
+	}
+	this->chessTurn = other.chessTurn;
+	this->whiteCheckmate = other.whiteCheckmate;
+	this->blackCheckmate = other.blackCheckmate;
+
+	// 반복 검사에 필요하기 때문에 둔 수의 기록도 복제함 (redo용 기록은 버림)
+	this->clearHistory();
+	for(size_t i = 0; i < other.historySize; i++)
+	{
+		HistoryEntry entry = other.history[i];
+		if(entry.captured != nullptr) entry.captured = entry.captured->clone();
+		this->history.push_back(entry);
+	}
+	this->historySize = other.historySize;
+	this->hash = other.hash;
+	this->halfmoveClock = other.halfmoveClock;
 }
 
 
@@ -229,6 +396,10 @@ void ChessEngine::resetBoard(const char *sequence)
 	this->updateCheckmate();
 	
 	this->chessTurn = PieceColor::WHITE;
+
+	this->clearHistory();
+	this->halfmoveClock = 0;
+	this->hash = this->computeHash();
 }
 
 
@@ -297,6 +468,11 @@ void ChessEngine::killPieceAt(int x, int y)
 	ChessPiece*& piece = this->chessBoard[y][x];
 	delete piece;
 	piece = nullptr;
+
+	// 수 기록과 맞지 않는 판이 되기 때문에 기록을 버림
+	this->clearHistory();
+	this->halfmoveClock = 0;
+	this->hash = this->computeHash();
 }
 
 
@@ -308,6 +484,8 @@ void ChessEngine::killPieceAt(int x, int y)
  */
 bool ChessEngine::isPieceMovableTo(int srcX, int srcY, int dstX, int dstY, bool checkTurn, bool checkCheckmate)
 {
+	chessStats.count(STAT_IS_PIECE_MOVABLE_TO);
+
 	if(srcX == dstX && srcY == dstY) return false; // src == dst일 때 false
 	if(srcX < 0 || 8 <= srcX || srcY < 0 || 8 <= srcY) return false; // src가 체스 판 밖일 때 false
 	if(dstX < 0 || 8 <= dstX || dstY < 0 || 8 <= dstY) return false; // dst가 체스 판 밖일 때 false
@@ -342,6 +520,8 @@ bool ChessEngine::isPieceMovableTo(int srcX, int srcY, int dstX, int dstY, bool
  */
 PathState ChessEngine::checkPath(int srcX, int srcY, int dstX, int dstY)
 {
+	chessStats.count(STAT_CHECK_PATH);
+
 	if(srcY == dstY) // x축과 평행한 직선 경로일 때
 	{
 		for(int x = min(srcX, dstX) + 1; x < max(srcX, dstX); x++)
@@ -412,6 +592,20 @@ ChessPiece* ChessEngine::forceMovePieceTo(int srcX, int srcY, int dstX, int dstY
  */
 bool ChessEngine::simulateCheckmate(PieceColor turn, int srcX, int srcY, int dstX, int dstY)
 {
+	if(turn == PieceColor::WHITE) return this->simulateCheckmate<PieceColor::WHITE>(srcX, srcY, dstX, dstY);
+	return this->simulateCheckmate<PieceColor::BLACK>(srcX, srcY, dstX, dstY);
+}
+
+
+/**
+ * simulateCheckmate()를 색깔 C에 대해 컴파일한 버전. C의 체크메이트 여부만 계산함.
+ */
+template<PieceColor C>
+bool ChessEngine::simulateCheckmate(int srcX, int srcY, int dstX, int dstY)
+{
+	chessStats.count(STAT_SIMULATE_CHECKMATE);
+	StatTimer timer(PHASE_SIMULATE_CHECKMATE);
+
 	// (srcX, srcY)에 있는 말(의 포인터)을 가져옴
 	ChessPiece* piece = this->getPieceAt(srcX, srcY);
 
@@ -439,12 +633,8 @@ bool ChessEngine::simulateCheckmate(PieceColor turn, int srcX, int srcY, int dst
 	// 그리고 움직일 말을 (srcX, srcY)에서 (dstX, dstY)로 움직임.
 	ChessPiece* eatenPiece = this->forceMovePieceTo(srcX, srcY, dstX, dstY);
 
-	// 체크메이트 여부를 계산함.
-	// 움직인 행위를 취소할거기 때문에 prevWhiteCM과 prevBlackCM에 이전 체크메이트 여부를 저장함.
-	bool prevWhiteCM = this->whiteCheckmate;
-	bool prevBlackCM = this->blackCheckmate;
-	this->updateCheckmate();
-	bool result = this->isCheckmate(turn);
+	// 체크메이트 여부를 계산함. (whiteCheckmate, blackCheckmate는 건드리지 않음)
+	bool result = this->calculateCheckmate<C>();
 
 	// 가상으로 움직인 행위를 취소함.
 	this->forceMovePieceTo(dstX, dstY, srcX, srcY);
@@ -456,57 +646,439 @@ bool ChessEngine::simulateCheckmate(PieceColor turn, int srcX, int srcY, int dst
 		this->forceMovePieceTo(cVDstX, srcY, cVSrcX, srcY);
 	}
 
-	// 체크메이트 여부를 원래대로 바꾼 후 리턴함
-	this->whiteCheckmate = prevWhiteCM;
-	this->blackCheckmate = prevBlackCM;
 	return result;
 }
 
 
 bool ChessEngine::movePieceTo(int srcX, int srcY, int dstX, int dstY)
 {
+	StatTimer timer(PHASE_MOVE_PIECE);
+
 	// src에서 dst로 움직일 수 없으면 false 리턴
 	if(!this->isPieceMovableTo(srcX, srcY, dstX, dstY, true, true)) return false;
 
+	// 새로운 수를 두면 되돌렸던 수들은 더 이상 redo()할 수 없음
+	this->truncateHistory();
+	this->applyMove(srcX, srcY, dstX, dstY);
+	return true;
+}
+
+
+/**
+ * movePieceTo()와 같지만 둘 수 있는 수인지 확인하지 않음.
+ * generateMoves()로 나온 수처럼 이미 확인된 수만 넣을 것. (탐색용)
+ */
+void ChessEngine::playMove(const ChessMove& move)
+{
+	StatTimer timer(PHASE_MOVE_PIECE);
+
+	this->truncateHistory();
+	this->applyMove(move.srcX, move.srcY, move.dstX, move.dstY);
+}
+
+
+/**
+ * 수를 실제로 판에 반영하고 기록에 남기는 함수. 둘 수 있는 수인지는 확인하지 않음.
+ */
+void ChessEngine::applyMove(int srcX, int srcY, int dstX, int dstY)
+{
 	// (srcX, srcY)에 있는 말(의 포인터)을 가져옴
 	ChessPiece* piece = this->getPieceAt(srcX, srcY);
 
 	// 캐슬링인지 확인함.
 	RookPiece* castlingRook = nullptr;
-	int cVSrcX, cVDstX; // cV: castlingVictim; 코드가 너무 길어져서 줄임
+	int cVSrcX = -1, cVDstX = -1; // cV: castlingVictim; 코드가 너무 길어져서 줄임
 	if(piece->type == PieceType::KING)
 	{
 		KingPiece* castlingKing = static_cast<KingPiece*>(piece);
 		castlingRook = castlingKing->getCastlingVictim(*this, dstX, dstY);
+		if(castlingRook != nullptr)
+		{
+			cVSrcX = castlingRook->x;
+			cVDstX = castlingKing->getCastlingRookDstX(*this, dstX, castlingRook);
+		}
 	}
 
-	// 말을 이동시킴.
+	// 되돌릴 때 필요한 정보를 기록함
+	HistoryEntry entry;
+	entry.move = { (signed char) srcX, (signed char) srcY, (signed char) dstX, (signed char) dstY };
+	entry.rookSrcX = cVSrcX; entry.rookDstX = cVDstX;
+	entry.pieceDidMove = getDidMove(piece);
+	entry.rookDidMove = castlingRook != nullptr && castlingRook->didMove;
+	entry.whiteCheckmate = this->whiteCheckmate;
+	entry.blackCheckmate = this->blackCheckmate;
+	entry.hash = this->hash;
+	entry.halfmoveClock = this->halfmoveClock;
+
+	// 물리 체스판에 보낼 정보는 판이 바뀌기 전에 만들어둠
+	this->movePhysicalPiece(srcX, srcY, dstX, dstY, cVSrcX, cVDstX, nullptr);
+
+	// 말을 이동시킴. 해시에서는 움직이기 전의 말을 빼고, 다 움직인 후에 다시 넣음
+	this->hash ^= ZOBRIST.of(piece);
 	ChessPiece* eatenPiece = this->forceMovePieceTo(srcX, srcY, dstX, dstY);
 
-	// 만약 eatenPiece가 있었다면 제거함. (무조건 movePhysicalPieceTo 이전에 실행해야 함)
+	// 만약 eatenPiece가 있었다면 판에서 치움. (되돌릴 수 있도록 delete하지 않고 기록에 남김)
 	if(eatenPiece != nullptr)
 	{
-		delete eatenPiece;
-		killPhysicalPieceAt(dstX, dstY);
+		this->hash ^= ZOBRIST.of(eatenPiece);
+	}
+	entry.captured = eatenPiece;
+
+	// 캐슬링이었다면 룩도 옮김. (이 때 y좌표는 움직이지 않으므로 srcY로 통일)
+	if(castlingRook != nullptr)
+	{
+		this->hash ^= ZOBRIST.of(castlingRook);
+		this->forceMovePieceTo(cVSrcX, srcY, cVDstX, srcY);
 	}
 
 	// whenMoved()를 실행함.
 	piece->whenMoved(*this, dstX, dstY);
+	this->hash ^= ZOBRIST.of(piece);
 	if(castlingRook != nullptr)
 	{
 		castlingRook->whenMoved(*this, cVDstX, srcY);
+		this->hash ^= ZOBRIST.of(castlingRook);
 	}
-	movePhysicalPieceTo(srcX, srcY, dstX, dstY);
+
+	// 말을 잡거나 폰을 움직이면 되돌릴 수 없는 수이므로 halfmove clock을 0으로
+	if(eatenPiece != nullptr || piece->type == PieceType::PAWN) this->halfmoveClock = 0;
+	else this->halfmoveClock++;
+
+	if(this->historySize < this->history.size()) this->history[this->historySize] = entry;
+	else this->history.push_back(entry);
+	this->historySize++;
 
 	// 체크메이트 여부를 다시 계산함.
 	this->updateCheckmate();
 
 	// 턴을 바꿈
 	this->chessTurn = this->chessTurn == PieceColor::WHITE ? PieceColor::BLACK : PieceColor::WHITE;
+	this->hash ^= ZOBRIST.whiteTurn;
+}
+
+
+/**
+ * 마지막으로 둔 수를 되돌리는 함수. 되돌린 수는 redo()로 다시 둘 수 있음.
+ * 물리 체스판에서도 움직인 말을 되돌려 놓은 후, 잡혔던 말을 무덤에서 다시 가져옴.
+ * @return 되돌릴 수가 없으면 false
+ */
+bool ChessEngine::undo()
+{
+	if(this->historySize == 0) return false;
+	HistoryEntry& entry = this->history[--this->historySize];
+	const ChessMove& m = entry.move;
+
+	// 물리 체스판은 판이 바뀌기 전에 보내야 함 (도착 칸이 비어있으므로 잡는 수로 처리되지 않음)
+	this->movePhysicalPiece(m.dstX, m.dstY, m.srcX, m.srcY, entry.rookDstX, entry.rookSrcX, entry.captured);
+
+	// 원래 자리는 비어있으므로 forceMovePieceTo()가 돌려주는 말은 없음
+	this->forceMovePieceTo(m.dstX, m.dstY, m.srcX, m.srcY);
+	ChessPiece* piece = this->getPieceAt(m.srcX, m.srcY);
+	setDidMove(piece, entry.pieceDidMove);
+	this->chessBoard[m.dstY][m.dstX] = entry.captured;
+	entry.captured = nullptr;
+
+	if(entry.rookSrcX >= 0)
+	{
+		this->forceMovePieceTo(entry.rookDstX, m.srcY, entry.rookSrcX, m.srcY);
+		setDidMove(this->getPieceAt(entry.rookSrcX, m.srcY), entry.rookDidMove);
+	}
+
+	this->whiteCheckmate = entry.whiteCheckmate;
+	this->blackCheckmate = entry.blackCheckmate;
+	this->hash = entry.hash;
+	this->halfmoveClock = entry.halfmoveClock;
+	this->chessTurn = this->chessTurn == PieceColor::WHITE ? PieceColor::BLACK : PieceColor::WHITE;
+	return true;
+}
+
+
+/**
+ * undo()로 되돌린 수를 다시 두는 함수.
+ * @return 다시 둘 수가 없으면 false
+ */
+bool ChessEngine::redo()
+{
+	if(this->historySize == this->history.size()) return false;
+	ChessMove move = this->history[this->historySize].move;
+	this->applyMove(move.srcX, move.srcY, move.dstX, move.dstY);
 	return true;
 }
 
 
+/**
+ * redo()용으로 남아있던 기록을 버림.
+ */
+void ChessEngine::truncateHistory()
+{
+	// 되돌린 기록은 잡힌 말을 판에 돌려놨기 때문에 갖고 있는 말이 없음
+	this->history.resize(this->historySize);
+}
+
+
+void ChessEngine::clearHistory()
+{
+	for(size_t i = 0; i < this->history.size(); i++) delete this->history[i].captured;
+	this->history.clear();
+	this->historySize = 0;
+}
+
+
+unsigned long long ChessEngine::computeHash()
+{
+	unsigned long long result = this->chessTurn == PieceColor::WHITE ? ZOBRIST.whiteTurn : 0;
+	for(int y = 0; y < 8; y++) for(int x = 0; x < 8; x++)
+	{
+		ChessPiece* piece = this->chessBoard[y][x];
+		if(piece != nullptr) result ^= ZOBRIST.of(piece);
+	}
+	return result;
+}
+
+
+unsigned long long ChessEngine::getHash()
+{
+	return this->hash;
+}
+
+
+/**
+ * 마지막으로 말을 잡거나 폰을 움직인 후 지난 수(반수)의 개수.
+ */
+int ChessEngine::getHalfmoveClock()
+{
+	return this->halfmoveClock;
+}
+
+
+/**
+ * 현재 포지션이 전에 몇 번 나왔는지 세는 함수.
+ * 말을 잡거나 폰을 움직이기 전의 포지션은 다시 나올 수 없기 때문에, halfmove clock만큼만 거슬러 올라가서 확인함.
+ */
+int ChessEngine::countRepetitions()
+{
+	int count = 0;
+	int limit = min(this->halfmoveClock, (int) this->historySize);
+	// history[historySize - back]에는 back수 전 포지션의 해시가 있음. 같은 차례인 포지션만 비교함.
+	for(int back = 2; back <= limit; back += 2)
+	{
+		if(this->history[this->historySize - back].hash == this->hash) count++;
+	}
+	return count;
+}
+
+
+/**
+ * 현재 포지션이 가장 최근에 나온 게 몇 수 전인지 알려주는 함수. 전에 나온 적이 없으면 0.
+ * (탐색에서 반복이 탐색 안에서 생긴 건지, 게임 기록까지 거슬러 올라간 건지 구분하는 데 씀)
+ */
+int ChessEngine::getRepetitionDistance()
+{
+	int limit = min(this->halfmoveClock, (int) this->historySize);
+	for(int back = 2; back <= limit; back += 2)
+	{
+		if(this->history[this->historySize - back].hash == this->hash) return back;
+	}
+	return 0;
+}
+
+
+bool ChessEngine::isThreefoldRepetition()
+{
+	return this->countRepetitions() >= 2;
+}
+
+
+bool ChessEngine::isFiftyMoveDraw()
+{
+	return this->halfmoveClock >= 100;
+}
+
+
+/**
+ * 물리 체스판 명령 큐를 연결하는 함수.
+ * 연결되어 있으면 movePieceTo()가 물리 명령을 큐에 넣기만 하고 바로 리턴하고,
+ * nullptr이면 chess_physical.h의 함수들을 그 자리에서 직접 부름.
+ * 큐에 넣은 명령이 실패해도 movePieceTo()의 결과는 바뀌지 않으므로, board->getFailedCount()로 확인해야 함.
+ */
+void ChessEngine::setPhysicalBoard(PhysicalBoard* board)
+{
+	this->physicalBoard = board;
+}
+
+
+/**
+ * false로 설정하면 movePieceTo()가 물리 체스판을 아예 건드리지 않음. (서버 등 물리 체스판이 없는 환경용)
+ */
+void ChessEngine::setPhysicalEnabled(bool enabled)
+{
+	this->physicalEnabled = enabled;
+}
+
+
+PhysicalBoard* ChessEngine::getPhysicalBoard()
+{
+	return this->physicalBoard;
+}
+
+
+/**
+ * 아직 판에 반영되지 않은 수를 물리 체스판에 보내는 함수. movePieceTo()에서 판을 바꾸기 전에 불러야 함.
+ * @param rookSrcX 캐슬링일 때 룩의 원래 x좌표. 캐슬링이 아니면 -1
+ * @param rookDstX 캐슬링일 때 룩이 옮겨갈 x좌표. 캐슬링이 아니면 -1
+ * @param restored undo()일 때 무덤에서 (srcX, srcY)로 다시 가져올 잡혔던 말. 없으면 nullptr
+ */
+void ChessEngine::movePhysicalPiece(int srcX, int srcY, int dstX, int dstY, int rookSrcX, int rookDstX, ChessPiece* restored)
+{
+	if(!this->physicalEnabled) return;
+
+	ChessPiece* eatenPiece = this->getPieceAt(dstX, dstY);
+	if(this->physicalBoard == nullptr)
+	{
+		// 잡힌 말은 무조건 movePhysicalPieceTo 이전에 치워야 함
+		if(eatenPiece != nullptr) killPhysicalPieceAt(dstX, dstY);
+		movePhysicalPieceTo(srcX, srcY, dstX, dstY);
+		if(rookSrcX >= 0) movePhysicalPieceTo(rookSrcX, srcY, rookDstX, srcY);
+		// 잡혔던 말은 움직인 말이 자리를 비운 후에 다시 놓아야 함
+		if(restored != nullptr) revivePhysicalPieceAt(srcX, srcY);
+		return;
+	}
+
+	PhysicalMoveRequest request;
+	for(int y = 0; y < 8; y++) for(int x = 0; x < 8; x++)
+	{
+		request.occupied[y][x] = this->chessBoard[y][x] != nullptr;
+	}
+	request.srcX = srcX; request.srcY = srcY;
+	request.dstX = dstX; request.dstY = dstY;
+	request.capture = eatenPiece != nullptr;
+	request.capturedIsWhite = eatenPiece != nullptr && eatenPiece->color == PieceColor::WHITE;
+	request.rookSrcX = rookSrcX; request.rookDstX = rookDstX;
+	request.restoreCaptured = restored != nullptr;
+	this->physicalBoard->submitMove(request);
+}
+
+
+/**
+ * 현재 턴인 쪽이 둘 수 있는 모든 움직임을 moves에 채워넣는 함수.
+ * moves는 최소 MAX_MOVES 크기여야 함.
+ * @return 채워넣은 움직임의 개수
+ */
+int ChessEngine::generateMoves(ChessMove* moves)
+{
+	// 색깔은 여기서 한 번만 확인하고, 그 아래는 색깔별로 컴파일된 코드가 돌아감
+	if(this->chessTurn == PieceColor::WHITE) return this->collectMoves<PieceColor::WHITE, false>(moves);
+	return this->collectMoves<PieceColor::BLACK, false>(moves);
+}
+
+
+/**
+ * 현재 턴인 쪽이 둘 수 있는 수가 하나라도 있는지 확인하는 함수.
+ * generateMoves()와 달리 처음 찾은 수에서 바로 멈춤.
+ */
+bool ChessEngine::hasLegalMove()
+{
+	if(this->chessTurn == PieceColor::WHITE) return this->collectMoves<PieceColor::WHITE, true>(nullptr) > 0;
+	return this->collectMoves<PieceColor::BLACK, true>(nullptr) > 0;
+}
+
+
+/**
+ * 색깔이 C인 말들이 둘 수 있는 수를 모음. isPieceMovableTo(..., true, true)로 확인한 것과 결과와 순서가 같음.
+ * 폰은 갈 수 있는 칸 4개만 확인하고, 다른 말은 모든 칸을 확인함.
+ * @param FirstOnly true면 수를 하나 찾자마자 1을 리턴함 (moves는 쓰지 않음)
+ */
+template<PieceColor C, bool FirstOnly>
+int ChessEngine::collectMoves(ChessMove* moves)
+{
+	typedef ColorTraits<C> Traits;
+	int count = 0;
+	auto add = [&](int srcX, int srcY, int dstX, int dstY) {
+		if(this->simulateCheckmate<C>(srcX, srcY, dstX, dstY)) return false;
+		if(!FirstOnly) moves[count] = { (signed char) srcX, (signed char) srcY, (signed char) dstX, (signed char) dstY };
+		count++;
+		return FirstOnly || count == MAX_MOVES;
+	};
+
+	for(int srcY = 0; srcY < 8; srcY++) for(int srcX = 0; srcX < 8; srcX++)
+	{
+		ChessPiece* piece = this->chessBoard[srcY][srcX];
+		if(piece == nullptr || piece->color != C) continue;
+
+		if(piece->type == PieceType::PAWN)
+		{
+			for(int i = 0; i < 4; i++)
+			{
+				int dstX = srcX + Traits::pawnTargets[i][0], dstY = srcY + Traits::pawnTargets[i][1];
+				if(dstX < 0 || 8 <= dstX || dstY < 0 || 8 <= dstY) continue;
+				if(!PawnPiece::isMovableTo<C>(*this, srcX, srcY, dstX, dstY)) continue;
+				if(add(srcX, srcY, dstX, dstY)) return count;
+			}
+			continue;
+		}
+
+		for(int dstY = 0; dstY < 8; dstY++) for(int dstX = 0; dstX < 8; dstX++)
+		{
+			if(srcX == dstX && srcY == dstY) continue;
+			ChessPiece* dstPiece = this->chessBoard[dstY][dstX];
+			if(dstPiece != nullptr && dstPiece->color == C) continue;
+			if(!piece->isMovableTo(*this, dstX, dstY)) continue;
+			if(add(srcX, srcY, dstX, dstY)) return count;
+		}
+	}
+	return count;
+}
+
+
+PieceColor ChessEngine::getTurn()
+{
+	return this->chessTurn;
+}
+
+
+/**
+ * 현재 판 상태를 position에 저장하는 함수. setPosition()으로 그대로 되돌릴 수 있음.
+ */
+void ChessEngine::getPosition(ChessPosition& position)
+{
+	position.movedMask = 0;
+	for(int y = 0; y < 8; y++) for(int x = 0; x < 8; x++)
+	{
+		ChessPiece* piece = this->chessBoard[y][x];
+		char& c = position.board[y * 8 + x];
+		if(piece == nullptr)
+		{
+			c = ' ';
+			continue;
+		}
+
+		c = static_cast<char>(piece->type);
+		if(piece->color == PieceColor::WHITE) c |= 0b00100000;
+
+		if(getDidMove(piece)) position.movedMask |= 1ULL << (y * 8 + x);
+	}
+	position.turn = this->chessTurn;
+}
+
+
+void ChessEngine::setPosition(const ChessPosition& position)
+{
+	char sequence[65];
+	memcpy(sequence, position.board, 64);
+	sequence[64] = '\0';
+	this->resetBoard(sequence);
+
+	for(int i = 0; i < 64; i++)
+	{
+		if((position.movedMask >> i & 1) == 0) continue;
+		ChessPiece* piece = this->chessBoard[i / 8][i % 8];
+		if(piece != nullptr) setDidMove(piece, true);
+	}
+	this->chessTurn = position.turn;
+	this->hash = this->computeHash();
+}
+
+
 /**
  * blackCheckmate 변수와 whiteCheckmate 변수를 업데이트시킴.
  * 판이 업데이트될 때마다 이 함수를 호출할 것.
@@ -514,17 +1086,25 @@ bool ChessEngine::movePieceTo(int srcX, int srcY, int dstX, int dstY)
  */
 void ChessEngine::updateCheckmate()
 {
+	chessStats.count(STAT_UPDATE_CHECKMATE);
+	StatTimer timer(PHASE_UPDATE_CHECKMATE);
+
 	// 체크메이트 여부: 흑 먼저, 그 다음에 백 확인
-    this->blackCheckmate = this->calculateCheckmate(PieceColor::BLACK, PieceColor::WHITE);
-    this->whiteCheckmate = this->calculateCheckmate(PieceColor::WHITE, PieceColor::BLACK);
+    this->blackCheckmate = this->calculateCheckmate<PieceColor::BLACK>();
+    this->whiteCheckmate = this->calculateCheckmate<PieceColor::WHITE>();
 }
 
 
-bool ChessEngine::calculateCheckmate(PieceColor victimColor, PieceColor opponentColor)
+/**
+ * 색깔이 C인 킹을 상대편 말이 잡을 수 있는지 계산함.
+ */
+template<PieceColor C>
+bool ChessEngine::calculateCheckmate()
 {
     // 킹이 어딨는지 확인
-	ChessPiece* kingPiece = this->findPiece(PieceType::KING, victimColor);
+	ChessPiece* kingPiece = this->findPiece(PieceType::KING, C);
 	if(kingPiece == nullptr) return false;
+	int kingX = kingPiece->x, kingY = kingPiece->y;
 
     // 킹을 찾았을 때, 체스 판을 모두 찾으면서 상대편 말이 나오면
     // 그 말이 킹을 잡을 수 있는지 확인.
@@ -535,11 +1115,18 @@ bool ChessEngine::calculateCheckmate(PieceColor victimColor, PieceColor opponent
 		if(piece == nullptr) continue;
 
 		// 말 색깔이 상대편 색깔이 아니면 스킵
-		if(piece->color != opponentColor) continue;
+		if(piece->color != ColorTraits<C>::opponent) continue;
+
+		// 상대편 폰은 킹 쪽으로 한 칸 대각선에 있을 때만 잡을 수 있음
+		if(piece->type == PieceType::PAWN)
+		{
+			if(kingY - y == ColorTraits<ColorTraits<C>::opponent>::forward && abs(kingX - x) == 1) return true;
+			continue;
+		}
 
         // 상대편 말이 킹을 잡을 수 있는지 확인
-		// 이 때 checkTurn=false, checkCheckmate=false로 잡아야 됨 (아니면 무한루프에 빠짐)
-		if(this->isPieceMovableTo(piece->x, piece->y, kingPiece->x, kingPiece->y, false, false)) return true;
+		// 이 때 체크메이트는 확인하면 안 됨 (아니면 무한루프에 빠짐)
+		if(piece->isMovableTo(*this, kingX, kingY)) return true;
 	}
 
 	return false;
@@ -2,7 +2,9 @@
 
 #include <iostream>
 #include <string.h>
-#include "chess_physical.h"
+#include <vector>
+#include "chess_physical_queue.h"
+#include "chess_stats.h"
 
 int min(int a, int b) { return a > b ? b : a; }
 int max(int a, int b) { return a > b ? a : b; }
@@ -28,6 +30,58 @@ enum PathState
 };
 
 
+/**
+ * 색깔마다 다른 값들. 템플릿 인자로 넘기면 컴파일 타임에 정해지기 때문에 색깔을 확인하는 분기가 사라짐.
+ * (y = 0이 8랭크라서 백은 y가 작아지는 쪽으로 전진함)
+ */
+template<PieceColor C> struct ColorTraits;
+
+template<> struct ColorTraits<PieceColor::WHITE>
+{
+	static constexpr PieceColor opponent = PieceColor::BLACK;
+	static constexpr int forward = -1;
+	static constexpr int pawnHomeRank = 6;   // 폰이 처음 있는 줄 (2칸 전진 가능)
+	static constexpr int pawnDoubleRank = 4; // 폰이 2칸 전진하면 도착하는 줄
+	static constexpr int backRank = 7;       // 킹과 룩이 처음 있는 줄 (캐슬링하는 줄)
+	// 폰이 갈 수 있는 칸 (dx, dy). generateMoves()의 순서(y, x 오름차순)에 맞춰둠
+	static constexpr signed char pawnTargets[4][2] = { { 0, -2 }, { -1, -1 }, { 0, -1 }, { 1, -1 } };
+};
+
+template<> struct ColorTraits<PieceColor::BLACK>
+{
+	static constexpr PieceColor opponent = PieceColor::WHITE;
+	static constexpr int forward = 1;
+	static constexpr int pawnHomeRank = 1;
+	static constexpr int pawnDoubleRank = 3;
+	static constexpr int backRank = 0;
+	static constexpr signed char pawnTargets[4][2] = { { -1, 1 }, { 0, 1 }, { 1, 1 }, { 0, 2 } };
+};
+
+
+/**
+ * 말 하나의 움직임. (srcX, srcY)에서 (dstX, dstY)로.
+ */
+struct ChessMove
+{
+	signed char srcX, srcY, dstX, dstY;
+};
+
+// generateMoves()에 넘기는 배열의 최소 크기
+const int MAX_MOVES = 256;
+
+
+/**
+ * 엔진 밖에 저장해둘 수 있는 판 상태. 말 객체 없이 값만 들고 있어서 복사가 자유로움.
+ * board는 resetBoard(const char*)와 같은 형식 (대문자 흑, 소문자 백, 공백은 빈 칸)
+ */
+struct ChessPosition
+{
+	char board[64];
+	unsigned long long movedMask; // (y * 8 + x)번째 비트: 그 자리의 킹/룩이 움직인 적 있는지
+	PieceColor turn;
+};
+
+
 class ChessPiece
 {
 public:
@@ -40,6 +94,11 @@ public:
 
 	virtual bool isMovableTo(ChessEngine&, int dstX, int dstY) = 0;
 
+	/**
+	 * 자기 자신과 똑같은 상태(위치, didMove 등)의 말을 새로 만들어서 리턴하는 함수.
+	 */
+	virtual ChessPiece* clone() = 0;
+
 	/**
 	 * 자기 자신이 움직여졌을 때 실행되는 함수.
 	 * 기본적으로 아무것도 하지 않음.
@@ -49,11 +108,28 @@ public:
 };
 
 
+/**
+ * 수 하나를 되돌리는 데 필요한 정보.
+ */
+struct HistoryEntry
+{
+	ChessMove move;
+	ChessPiece* captured;           // 잡힌 말. 되돌리기 전까지는 이 기록이 갖고 있음
+	int rookSrcX, rookDstX;         // 캐슬링이 아니면 -1
+	bool pieceDidMove, rookDidMove; // 수를 두기 전의 didMove
+	bool whiteCheckmate, blackCheckmate;
+	unsigned long long hash;        // 수를 두기 전 포지션의 해시
+	int halfmoveClock;              // 수를 두기 전의 halfmove clock
+};
+
+
 class ChessEngine
 {
 public:
 	ChessEngine();
+	ChessEngine(const ChessEngine& other);
 	~ChessEngine();
+	ChessEngine& operator=(const ChessEngine& other);
 
 	void resetBoard();
 	void resetBoard(const char *sequence);
@@ -70,13 +146,49 @@ public:
 
 	ChessPiece* forceMovePieceTo(int srcX, int srcY, int dstX, int dstY);
 	bool movePieceTo(int srcX, int srcY, int dstX, int dstY);
+	void playMove(const ChessMove& move);
+	bool undo();
+	bool redo();
+	int generateMoves(ChessMove* moves);
+	bool hasLegalMove();
+	PieceColor getTurn();
+	unsigned long long getHash();
+	int getHalfmoveClock();
+	int countRepetitions();
+	int getRepetitionDistance();
+	bool isThreefoldRepetition();
+	bool isFiftyMoveDraw();
+	void getPosition(ChessPosition& position);
+	void setPosition(const ChessPosition& position);
 	void printBoard(std::ostream& out, int selX, int selY);
 
+	void setPhysicalBoard(PhysicalBoard* board);
+	void setPhysicalEnabled(bool enabled);
+	PhysicalBoard* getPhysicalBoard();
+
 private:
 	ChessPiece* chessBoard[8][8];
 	PieceColor chessTurn;
 	bool whiteCheckmate, blackCheckmate;
+	PhysicalBoard* physicalBoard;
+	bool physicalEnabled;
+
+	// history[0 ~ historySize-1]는 둔 수, history[historySize ~]는 되돌려서 redo()로 다시 둘 수 있는 수
+	std::vector<HistoryEntry> history;
+	size_t historySize;
+	unsigned long long hash;
+	int halfmoveClock;
 
 	void updateCheckmate();
-	bool calculateCheckmate(PieceColor victimColor, PieceColor opponentColor);
+	template<PieceColor C> bool calculateCheckmate();
+	template<PieceColor C> bool simulateCheckmate(int srcX, int srcY, int dstX, int dstY);
+	template<PieceColor C, bool FirstOnly> int collectMoves(ChessMove* moves);
+	void copyFrom(const ChessEngine& other);
+	void applyMove(int srcX, int srcY, int dstX, int dstY);
+	void truncateHistory();
+	void clearHistory();
+	unsigned long long computeHash();
+	void movePhysicalPiece(int srcX, int srcY, int dstX, int dstY, int rookSrcX, int rookDstX, ChessPiece* restored);
+
+	friend struct ChessBench;
 };
@@ -7,6 +7,8 @@
 
 void ChessEngine::printBoard(std::ostream &out, int selX, int selY)
 {
+	StatTimer timer(PHASE_PRINT_BOARD);
+
 	char printMatrix[8][8], printCoverTensor[8][8][2];
 	for(int y = 0; y < 8; y++) for(int x = 0; x < 8; x++)
 	{
@@ -0,0 +1,491 @@
+#pragma once
+
+//
+// 게임 모음에서 "이 포지션이 나온 게임들과, 그 다음에 둔 수"를 찾기 위한 포지션 인덱스.
+//
+// 인덱서는 게임을 엔진으로 다시 둬보면서 매 포지션마다 (해시, 게임 번호, 몇 번째 수, 다음 수) 항목을 만들고,
+// 해시 순으로 정렬해서 파일에 씀. 쿼리는 파일을 mmap해서 이진 탐색만 하기 때문에 할당 없이 바로 답할 수 있음.
+//
+// 파일 포맷 (리틀 엔디언):
+//   헤더 32바이트: "CIDX" + 버전(4바이트) + 항목 수(8바이트) + 게임 수(8바이트) + 예약(8바이트)
+//   그 다음 PositionIndexEntry가 (hash, gameId, ply) 순으로 정렬되어 이어짐
+//
+// 해시는 엔진의 getHash()라서 킹/룩의 didMove와 차례까지 같아야 같은 포지션으로 봄.
+// 게임 번호는 입력 파일에서 게임이 나온 순서 (0부터)이고, 스레드 수와 상관없이 항상 같은 파일이 나옴.
+//
+// 게임이 많으면 항목이 메모리에 다 들어가지 않기 때문에, 스레드마다 항목이 runEntries개 모이면
+// 정렬해서 임시 run 파일(INDEX.runN)로 쓰고, 마지막에 모든 run을 병합해서 인덱스 파일을 만듦.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <istream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+const char POSITION_INDEX_MAGIC[4] = { 'C', 'I', 'D', 'X' };
+const unsigned int POSITION_INDEX_VERSION = 1;
+const int POSITION_INDEX_HEADER_SIZE = 32;
+
+// 게임이 이 포지션에서 끝났으면 move가 이 값
+const unsigned short POSITION_INDEX_NO_MOVE = 0xFFFF;
+
+
+struct PositionIndexEntry
+{
+	unsigned long long hash;
+	unsigned int gameId;
+	unsigned short ply;  // 게임 시작 포지션이 0
+	unsigned short move; // 하위 6비트 출발 칸(y * 8 + x), 그 위 6비트 도착 칸. 없으면 POSITION_INDEX_NO_MOVE
+
+	bool operator<(const PositionIndexEntry& other) const
+	{
+		if(this->hash != other.hash) return this->hash < other.hash;
+		if(this->gameId != other.gameId) return this->gameId < other.gameId;
+		return this->ply < other.ply;
+	}
+};
+
+static_assert(sizeof(PositionIndexEntry) == 16, "PositionIndexEntry must be 16 bytes");
+
+
+unsigned short encodeIndexMove(const ChessMove& move)
+{
+	return (move.srcY * 8 + move.srcX) | (move.dstY * 8 + move.dstX) << 6;
+}
+
+
+ChessMove decodeIndexMove(unsigned short code)
+{
+	ChessMove move;
+	move.srcX = code & 7;
+	move.srcY = code >> 3 & 7;
+	move.dstX = code >> 6 & 7;
+	move.dstY = code >> 9 & 7;
+	return move;
+}
+
+
+/**
+ * 한 포지션에서 둔 수 하나의 통계
+ */
+struct PositionMoveStat
+{
+	ChessMove move;
+	unsigned int count;       // 이 수를 둔 횟수
+	unsigned int firstGameId; // 이 수를 둔 게임 중 번호가 가장 작은 게임
+};
+
+
+/**
+ * 한 포지션의 쿼리 결과. 수 목록은 호출한 쪽이 준 배열에 채움
+ */
+struct PositionQueryResult
+{
+	unsigned int games;       // 이 포지션이 나온 게임 수 (한 게임에서 여러 번 나와도 하나로 셈)
+	unsigned int occurrences; // 이 포지션이 나온 횟수
+	unsigned int endedHere;   // 이 포지션에서 끝난 횟수
+	int moveCount;            // stats에 채운 수의 개수 (많이 둔 순서)
+};
+
+
+struct PositionIndexBuildStats
+{
+	unsigned long long games, entries, badGames, runs;
+};
+
+
+/**
+ * 게임 모음을 읽어서 인덱스 파일을 만드는 클래스.
+ */
+class PositionIndexBuilder
+{
+public:
+	/**
+	 * 첫 번째 인자로 읽지 못한 게임의 번호, 두 번째로 읽지 못한 수를 넘김. (락을 잡은 채로 불림)
+	 */
+	std::function<void(unsigned int, const std::string&)> onBadMove;
+
+	/**
+	 * @param runEntries 모든 스레드를 합쳐서 메모리에 둘 최대 항목 수
+	 */
+	PositionIndexBuilder(int threadCount_, size_t runEntries_)
+		: threadCount(threadCount_ < 1 ? 1 : threadCount_), runEntries(runEntries_)
+	{}
+
+	/**
+	 * pgn의 모든 게임으로 path에 인덱스를 만듦.
+	 * @return 파일을 쓸 수 없으면 false
+	 */
+	bool build(std::istream& pgn, const char* path, PositionIndexBuildStats& stats)
+	{
+		PgnReader reader(pgn);
+		this->path = path;
+		this->reader = &reader;
+		this->nextGameId = 0;
+		this->runCount = 0;
+		this->runSizes.clear();
+		this->badGames = 0;
+		this->failed = false;
+
+		std::vector<std::thread> threads;
+		for(int t = 0; t < this->threadCount; t++) threads.emplace_back(&PositionIndexBuilder::work, this);
+		for(std::thread& thread : threads) thread.join();
+		this->reader = nullptr;
+
+		stats.games = this->nextGameId;
+		stats.badGames = this->badGames;
+		stats.runs = this->runCount;
+		stats.entries = 0;
+		for(size_t size : this->runSizes) stats.entries += size;
+		if(this->failed)
+		{
+			this->removeRuns();
+			return false;
+		}
+		return this->merge(stats.entries, stats.games);
+	}
+
+private:
+	static constexpr size_t MERGE_BUFFER_ENTRIES = 4096;
+
+	int threadCount;
+	size_t runEntries;
+	std::string path;
+
+	std::mutex mutex; // reader, nextGameId, runSizes, badGames, onBadMove
+	PgnReader* reader;
+	unsigned int nextGameId;
+	std::vector<size_t> runSizes; // run 번호 -> 항목 수
+	unsigned long long badGames;
+	std::atomic<int> runCount;
+	std::atomic<bool> failed;
+
+	std::string runPath(int run)
+	{
+		return this->path + ".run" + std::to_string(run);
+	}
+
+	void removeRuns()
+	{
+		for(int r = 0; r < this->runCount; r++) remove(this->runPath(r).c_str());
+	}
+
+	void work()
+	{
+		ChessEngine engine;
+		engine.setPhysicalEnabled(false);
+		ChessPosition start;
+		parseFen(START_FEN, start);
+		PgnGame game;
+		std::vector<PositionIndexEntry> entries;
+		entries.reserve(this->runEntries / this->threadCount);
+
+		while(true)
+		{
+			unsigned int gameId;
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+				if(!this->reader->next(game)) break;
+				gameId = this->nextGameId++;
+			}
+
+			ChessPosition position;
+			if(game.fen.empty()) position = start;
+			else if(!parseFen(game.fen.c_str(), position))
+			{
+				this->reportBadMove(gameId, "FEN " + game.fen);
+				continue;
+			}
+			engine.setPosition(position);
+
+			// 읽을 수 없는 수가 나오면 그 전까지만 넣음
+			size_t ply = 0;
+			for(; ply < game.moves.size() && ply < POSITION_INDEX_NO_MOVE; ply++)
+			{
+				ChessMove move;
+				if(!parseMove(engine, game.moves[ply], move))
+				{
+					this->reportBadMove(gameId, game.moves[ply]);
+					break;
+				}
+				entries.push_back({ engine.getHash(), gameId, (unsigned short) ply, encodeIndexMove(move) });
+				engine.playMove(move);
+			}
+			// 끝까지 읽은 게임만 여기서 끝났다고 기록함. 중간에 멈춘 게임은 끝난 곳을 모름
+			if(ply == game.moves.size()) entries.push_back({ engine.getHash(), gameId, (unsigned short) ply, POSITION_INDEX_NO_MOVE });
+
+			if(entries.size() >= this->runEntries / this->threadCount) this->writeRun(entries);
+		}
+		this->writeRun(entries);
+	}
+
+	void reportBadMove(unsigned int gameId, const std::string& move)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->badGames++;
+		if(this->onBadMove) this->onBadMove(gameId, move);
+	}
+
+	/**
+	 * entries를 정렬해서 run 파일로 쓰고 비움
+	 */
+	void writeRun(std::vector<PositionIndexEntry>& entries)
+	{
+		if(entries.empty()) return;
+		std::sort(entries.begin(), entries.end());
+
+		int run = this->runCount++;
+		FILE* file = fopen(this->runPath(run).c_str(), "wb");
+		if(file == nullptr || fwrite(entries.data(), sizeof(PositionIndexEntry), entries.size(), file) != entries.size())
+		{
+			this->failed = true;
+		}
+		if(file != nullptr) fclose(file);
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if((int) this->runSizes.size() <= run) this->runSizes.resize(run + 1);
+		this->runSizes[run] = entries.size();
+		entries.clear();
+	}
+
+	/**
+	 * run 파일들을 병합해서 인덱스 파일을 쓰고 run 파일을 지움
+	 */
+	bool merge(unsigned long long entryCount, unsigned long long gameCount)
+	{
+		struct Run
+		{
+			FILE* file;
+			std::vector<PositionIndexEntry> buffer;
+			size_t index;
+
+			bool fill()
+			{
+				this->buffer.resize(MERGE_BUFFER_ENTRIES);
+				this->buffer.resize(fread(this->buffer.data(), sizeof(PositionIndexEntry), MERGE_BUFFER_ENTRIES, this->file));
+				this->index = 0;
+				return !this->buffer.empty();
+			}
+		};
+
+		int count = this->runCount;
+		std::vector<Run> runs(count);
+		bool ok = true;
+		for(int r = 0; r < count; r++)
+		{
+			runs[r].file = fopen(this->runPath(r).c_str(), "rb");
+			if(runs[r].file == nullptr) ok = false;
+		}
+
+		FILE* out = ok ? fopen(this->path.c_str(), "wb") : nullptr;
+		if(out != nullptr)
+		{
+			unsigned char header[POSITION_INDEX_HEADER_SIZE] = { 0 };
+			memcpy(header, POSITION_INDEX_MAGIC, 4);
+			memcpy(header + 4, &POSITION_INDEX_VERSION, 4);
+			memcpy(header + 8, &entryCount, 8);
+			memcpy(header + 16, &gameCount, 8);
+			fwrite(header, 1, POSITION_INDEX_HEADER_SIZE, out);
+
+			// (항목, run 번호)의 최소 힙
+			typedef std::pair<PositionIndexEntry, int> Head;
+			auto greater = [](const Head& a, const Head& b) { return b.first < a.first; };
+			std::priority_queue<Head, std::vector<Head>, decltype(greater)> heads(greater);
+			for(int r = 0; r < count; r++)
+			{
+				if(runs[r].fill()) heads.push({ runs[r].buffer[0], r });
+			}
+
+			std::vector<PositionIndexEntry> output;
+			output.reserve(MERGE_BUFFER_ENTRIES);
+			unsigned long long written = 0;
+			while(!heads.empty())
+			{
+				Head head = heads.top();
+				heads.pop();
+				output.push_back(head.first);
+				if(output.size() == MERGE_BUFFER_ENTRIES)
+				{
+					written += fwrite(output.data(), sizeof(PositionIndexEntry), output.size(), out);
+					output.clear();
+				}
+
+				Run& run = runs[head.second];
+				if(++run.index < run.buffer.size() || run.fill()) heads.push({ run.buffer[run.index], head.second });
+			}
+			written += fwrite(output.data(), sizeof(PositionIndexEntry), output.size(), out);
+			ok = fclose(out) == 0 && written == entryCount;
+		}
+		else ok = false;
+
+		for(int r = 0; r < count; r++)
+		{
+			if(runs[r].file != nullptr) fclose(runs[r].file);
+		}
+		this->removeRuns();
+		return ok;
+	}
+};
+
+
+/**
+ * mmap한 인덱스 파일에 대한 쿼리. open() 후에는 할당하지 않음.
+ * 여러 스레드에서 동시에 쿼리해도 됨.
+ */
+class PositionIndex
+{
+public:
+	PositionIndex()
+		: data(nullptr), size(0), entries(nullptr), entryCount(0), gameCount(0)
+	{}
+
+	~PositionIndex()
+	{
+		this->close();
+	}
+
+	/**
+	 * @return 파일이 없거나 형식이 맞지 않으면 false
+	 */
+	bool open(const char* path)
+	{
+		this->close();
+		int fd = ::open(path, O_RDONLY);
+		if(fd < 0) return false;
+		struct stat st;
+		bool ok = fstat(fd, &st) == 0 && st.st_size >= POSITION_INDEX_HEADER_SIZE;
+		if(ok)
+		{
+			void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			if(mapped != MAP_FAILED)
+			{
+				this->data = (const unsigned char*) mapped;
+				this->size = st.st_size;
+			}
+		}
+		::close(fd);
+		if(this->data == nullptr) return false;
+
+		unsigned int version;
+		memcpy(&version, this->data + 4, 4);
+		memcpy(&this->entryCount, this->data + 8, 8);
+		memcpy(&this->gameCount, this->data + 16, 8);
+		if(memcmp(this->data, POSITION_INDEX_MAGIC, 4) != 0 || version != POSITION_INDEX_VERSION
+			// 곱하면 넘칠 수 있으므로 파일 크기에서 들어갈 수 있는 항목 수와 비교
+			|| this->entryCount > (this->size - POSITION_INDEX_HEADER_SIZE) / sizeof(PositionIndexEntry)
+			|| this->size != POSITION_INDEX_HEADER_SIZE + this->entryCount * sizeof(PositionIndexEntry))
+		{
+			this->close();
+			return false;
+		}
+		this->entries = (const PositionIndexEntry*) (this->data + POSITION_INDEX_HEADER_SIZE);
+		// 쿼리는 이진 탐색이라 앞뒤로 미리 읽어봐야 소용없음
+		madvise((void*) this->data, this->size, MADV_RANDOM);
+		return true;
+	}
+
+	void close()
+	{
+		if(this->data != nullptr) munmap((void*) this->data, this->size);
+		this->data = nullptr;
+		this->entries = nullptr;
+		this->size = 0;
+		this->entryCount = this->gameCount = 0;
+	}
+
+	unsigned long long getEntryCount() const { return this->entryCount; }
+	unsigned long long getGameCount() const { return this->gameCount; }
+	const PositionIndexEntry& getEntry(unsigned long long i) const { return this->entries[i]; }
+
+	/**
+	 * hash인 항목들을 찾음. 항목들은 게임 번호, 수 순서로 정렬되어 있음.
+	 * @return 항목 개수 (없으면 0)
+	 */
+	size_t find(unsigned long long hash, const PositionIndexEntry*& first) const
+	{
+		const PositionIndexEntry* end = this->entries + this->entryCount;
+		first = std::lower_bound(this->entries, end, hash,
+			[](const PositionIndexEntry& e, unsigned long long h) { return e.hash < h; });
+		const PositionIndexEntry* last = first;
+		while(last != end && last->hash == hash) last++;
+		return last - first;
+	}
+
+	/**
+	 * hash인 포지션 다음에 둔 수들의 통계를 stats에 많이 둔 순서로 채움.
+	 * @param maxStats stats 배열 크기. 수가 더 많으면 많이 둔 것부터 maxStats개만 채움
+	 */
+	PositionQueryResult query(unsigned long long hash, PositionMoveStat* stats, int maxStats) const
+	{
+		PositionQueryResult result = { 0, 0, 0, 0 };
+		const PositionIndexEntry* first;
+		size_t count = this->find(hash, first);
+
+		// 한 포지션에서 둘 수 있는 수는 MAX_MOVES개를 넘지 않기 때문에 스택 배열로 충분함
+		PositionMoveStat all[MAX_MOVES];
+		unsigned short codes[MAX_MOVES];
+		int moveCount = 0;
+		for(size_t i = 0; i < count; i++)
+		{
+			const PositionIndexEntry& e = first[i];
+			result.occurrences++;
+			if(i == 0 || first[i - 1].gameId != e.gameId) result.games++;
+			if(e.move == POSITION_INDEX_NO_MOVE)
+			{
+				result.endedHere++;
+				continue;
+			}
+
+			int m = 0;
+			while(m < moveCount && codes[m] != e.move) m++;
+			if(m == moveCount)
+			{
+				// 해시 충돌이 아니면 넘칠 일이 없지만, 파일이 이상해도 스택을 넘지 않게 막아둠
+				if(moveCount == MAX_MOVES) continue;
+				codes[m] = e.move;
+				all[m] = { decodeIndexMove(e.move), 0, e.gameId };
+				moveCount++;
+			}
+			all[m].count++;
+		}
+
+		// 많이 둔 순서, 같으면 먼저 나온 게임 순서로 삽입 정렬
+		for(int i = 1; i < moveCount; i++)
+		{
+			PositionMoveStat stat = all[i];
+			int j = i;
+			for(; j > 0 && (all[j - 1].count < stat.count
+				|| (all[j - 1].count == stat.count && all[j - 1].firstGameId > stat.firstGameId)); j--)
+			{
+				all[j] = all[j - 1];
+			}
+			all[j] = stat;
+		}
+		result.moveCount = moveCount < maxStats ? moveCount : maxStats;
+		for(int i = 0; i < result.moveCount; i++) stats[i] = all[i];
+		return result;
+	}
+
+	PositionQueryResult query(ChessEngine& engine, PositionMoveStat* stats, int maxStats) const
+	{
+		return this->query(engine.getHash(), stats, maxStats);
+	}
+
+private:
+	const unsigned char* data;
+	size_t size;
+	const PositionIndexEntry* entries;
+	unsigned long long entryCount, gameCount;
+};
@@ -0,0 +1,297 @@
+#pragma once
+
+//
+// 두 탐색 설정끼리 자가 대국을 여러 스레드로 동시에 돌리고, SPRT로 결과가 유의미해지면 바로 멈추는 매치 러너.
+//
+// 오프닝 하나당 색을 바꿔서 두 판씩 둬서 오프닝의 유불리가 상쇄되게 함.
+// 깊이만 제한한 탐색은 같은 포지션에서 항상 같은 수를 두기 때문에, 같은 오프닝의 두 판씩은 매번 똑같은 게임이 됨.
+// 그래서 쌍마다 오프닝 뒤에 randomPlies개의 수를 쌍 번호로 정해지는 무작위 수로 둬서 쌍끼리 다른 게임이 되게 함.
+// (같은 쌍의 두 판은 같은 수로 시작해서 색만 바뀜)
+// 게임은 체크메이트/스테일메이트, 3회 반복/50수 규칙, 점수 기준(기권/무승부 판정), 최대 수 제한으로 끝남.
+//
+// SPRT는 3항(승/무/패) 결과에 대한 정규 근사 로그 우도비(LLR)를 씀:
+//   LLR = N * (s1 - s0) * (2 * s - s0 - s1) / (2 * var)
+//   s는 평균 점수, var는 게임 하나의 점수 분산, s0/s1은 elo0/elo1에 해당하는 기대 점수.
+// LLR이 log((1 - beta) / alpha) 이상이면 H1(elo1만큼 강함), log(beta / (1 - alpha)) 이하면 H0를 채택함.
+//
+
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * 한 쪽 엔진의 설정.
+ */
+struct MatchPlayer
+{
+	SearchLimits limits;
+};
+
+
+struct MatchSettings
+{
+	MatchPlayer a, b;
+	int maxGames;        // 이만큼 두면 SPRT 결과와 상관없이 멈춤
+	int threadCount;
+	int maxPlies;        // 이만큼 두면 무승부
+	int randomPlies;     // 오프닝 뒤에 쌍마다 무작위로 둘 수 (0이면 오프닝 그대로 시작)
+
+	// 한 쪽 점수가 -resignScore 이하인 수가 resignMoves번 연속으로 나오면 그 쪽이 짐 (0이면 끔)
+	int resignScore, resignMoves;
+	// drawPly 이후로 양쪽 점수의 절댓값이 drawScore 이하인 수가 drawMoves번 연속으로 나오면 무승부 (0이면 끔)
+	int drawScore, drawMoves, drawPly;
+
+	double elo0, elo1, alpha, beta;
+};
+
+
+enum class MatchOutcome
+{
+	A_WINS, DRAW, B_WINS
+};
+
+enum MatchEndReason
+{
+	END_CHECKMATE, END_STALEMATE, END_REPETITION, END_FIFTY_MOVES, END_RESIGN, END_DRAW_SCORE, END_MAX_PLIES,
+	END_REASON_COUNT
+};
+
+const char* const MATCH_END_REASON_NAMES[END_REASON_COUNT] = {
+	"checkmate", "stalemate", "repetition", "fifty moves", "resign adjudication", "draw adjudication", "max plies"
+};
+
+
+enum class SprtState
+{
+	CONTINUE, ACCEPT_H0, ACCEPT_H1
+};
+
+
+/**
+ * Elo 차이 -> A의 기대 점수 (로지스틱)
+ */
+double eloToScore(double elo)
+{
+	return 1 / (1 + pow(10, -elo / 400));
+}
+
+
+double scoreToElo(double score)
+{
+	// 0이나 1이면 무한대가 되므로 살짝 안쪽으로 잘라줌
+	if(score < 1e-6) score = 1e-6;
+	if(score > 1 - 1e-6) score = 1 - 1e-6;
+	return -400 * log10(1 / score - 1);
+}
+
+
+struct MatchTally
+{
+	unsigned long long wins, draws, losses; // A 기준
+	unsigned long long reasons[END_REASON_COUNT];
+	unsigned long long plies;
+
+	unsigned long long games() const { return this->wins + this->draws + this->losses; }
+
+	double score() const
+	{
+		return this->games() == 0 ? 0.5 : (this->wins + 0.5 * this->draws) / this->games();
+	}
+
+	/**
+	 * 게임 하나의 점수 분산
+	 */
+	double variance() const
+	{
+		if(this->games() == 0) return 0;
+		double s = this->score(), n = this->games();
+		return (this->wins * (1 - s) * (1 - s) + this->draws * (0.5 - s) * (0.5 - s) + this->losses * s * s) / n;
+	}
+
+	double llr(double elo0, double elo1) const
+	{
+		double var = this->variance();
+		if(var <= 0) return 0;
+		double s0 = eloToScore(elo0), s1 = eloToScore(elo1);
+		return this->games() * (s1 - s0) * (2 * this->score() - s0 - s1) / (2 * var);
+	}
+
+	/**
+	 * Elo 추정값과 95% 신뢰구간의 반폭
+	 */
+	void elo(double& elo, double& error) const
+	{
+		double s = this->score();
+		double margin = this->games() == 0 ? 0 : 1.96 * sqrt(this->variance() / this->games());
+		elo = scoreToElo(s);
+		error = (scoreToElo(s + margin) - scoreToElo(s - margin)) / 2;
+	}
+};
+
+
+SprtState sprtState(double llr, double alpha, double beta)
+{
+	if(llr >= log((1 - beta) / alpha)) return SprtState::ACCEPT_H1;
+	if(llr <= log(beta / (1 - alpha))) return SprtState::ACCEPT_H0;
+	return SprtState::CONTINUE;
+}
+
+
+class MatchRunner
+{
+public:
+	/**
+	 * 게임이 하나 끝날 때마다 불림. (진행 상황 출력용, 결과를 합치는 락을 잡은 채로 불림)
+	 */
+	std::function<void(const MatchTally&)> onGame;
+
+	MatchRunner(const MatchSettings& settings_, const std::vector<ChessPosition>& openings_)
+		: settings(settings_), openings(openings_), nextGame(0), stopFlag(false)
+	{
+		this->tally = MatchTally();
+	}
+
+	/**
+	 * 매치를 끝까지 돌림. SPRT가 결론을 내면 진행 중인 게임까지만 두고 멈춤.
+	 * @return 최종 결과
+	 */
+	MatchTally run()
+	{
+		this->startTime = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for(int t = 0; t < this->settings.threadCount; t++) threads.emplace_back(&MatchRunner::work, this);
+		for(std::thread& thread : threads) thread.join();
+		return this->tally;
+	}
+
+	double elapsedSeconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - this->startTime).count();
+	}
+
+private:
+	MatchSettings settings;
+	std::vector<ChessPosition> openings;
+	std::atomic<int> nextGame;
+	std::atomic<bool> stopFlag;
+	std::mutex mutex;
+	MatchTally tally;
+	std::chrono::steady_clock::time_point startTime;
+
+	void work()
+	{
+		ChessEngine engine;
+		engine.setPhysicalEnabled(false);
+		ChessSearch search;
+
+		while(!this->stopFlag.load())
+		{
+			int game = this->nextGame++;
+			if(game >= this->settings.maxGames) break;
+
+			// 같은 오프닝을 색을 바꿔서 두 번씩
+			const ChessPosition& opening = this->openings[(game / 2) % this->openings.size()];
+			engine.setPosition(opening);
+			this->playRandomPlies(engine, game / 2);
+			bool aIsWhite = game % 2 == 0;
+
+			int plies;
+			MatchEndReason reason;
+			PieceColor winner;
+			bool decisive = this->playGame(engine, search, aIsWhite, plies, reason, winner);
+
+			MatchOutcome outcome = !decisive ? MatchOutcome::DRAW
+				: (winner == PieceColor::WHITE) == aIsWhite ? MatchOutcome::A_WINS : MatchOutcome::B_WINS;
+
+			std::lock_guard<std::mutex> lock(this->mutex);
+			if(outcome == MatchOutcome::A_WINS) this->tally.wins++;
+			else if(outcome == MatchOutcome::B_WINS) this->tally.losses++;
+			else this->tally.draws++;
+			this->tally.reasons[reason]++;
+			this->tally.plies += plies;
+			if(this->onGame) this->onGame(this->tally);
+
+			double llr = this->tally.llr(this->settings.elo0, this->settings.elo1);
+			if(sprtState(llr, this->settings.alpha, this->settings.beta) != SprtState::CONTINUE) this->stopFlag.store(true);
+		}
+	}
+
+	/**
+	 * 쌍 번호 pair로 정해지는 무작위 수를 randomPlies개 둠. 둘 수가 없으면 거기서 멈춤.
+	 */
+	void playRandomPlies(ChessEngine& engine, int pair)
+	{
+		unsigned long long state = pair;
+		for(int i = 0; i < this->settings.randomPlies; i++)
+		{
+			ChessMove moves[MAX_MOVES];
+			int moveCount = engine.generateMoves(moves);
+			if(moveCount == 0) break;
+			engine.playMove(moves[ZobristKeys::next(state) % moveCount]);
+		}
+	}
+
+	/**
+	 * engine의 현재 포지션부터 한 판을 끝까지 둠.
+	 * @return 승부가 났으면 true이고 이긴 쪽이 winner에 들어감. 무승부면 false
+	 */
+	bool playGame(ChessEngine& engine, ChessSearch& search, bool aIsWhite, int& plies, MatchEndReason& reason, PieceColor& winner)
+	{
+		const MatchSettings& s = this->settings;
+		int losingStreak[2] = { 0, 0 }; // [0] 흑, [1] 백
+		int drawStreak = 0;
+
+		for(plies = 0; ; plies++)
+		{
+			PieceColor turn = engine.getTurn();
+			PieceColor opponent = turn == PieceColor::WHITE ? PieceColor::BLACK : PieceColor::WHITE;
+			if(!engine.hasLegalMove())
+			{
+				if(engine.isCheckmate(turn))
+				{
+					reason = END_CHECKMATE;
+					winner = opponent;
+					return true;
+				}
+				reason = END_STALEMATE;
+				return false;
+			}
+			if(engine.isThreefoldRepetition()) { reason = END_REPETITION; return false; }
+			if(engine.isFiftyMoveDraw()) { reason = END_FIFTY_MOVES; return false; }
+			if(plies >= s.maxPlies) { reason = END_MAX_PLIES; return false; }
+
+			bool aToMove = (turn == PieceColor::WHITE) == aIsWhite;
+			SearchResult result = search.search(engine, aToMove ? s.a.limits : s.b.limits, nullptr);
+
+			// 점수 판정: 두는 쪽의 점수가 계속 나쁘면 기권, 양쪽이 계속 비슷하다고 보면 무승부
+			int side = turn == PieceColor::WHITE;
+			losingStreak[side] = result.score <= -s.resignScore ? losingStreak[side] + 1 : 0;
+			if(s.resignMoves > 0 && losingStreak[side] >= s.resignMoves)
+			{
+				reason = END_RESIGN;
+				winner = opponent;
+				return true;
+			}
+			drawStreak = plies >= s.drawPly && abs(result.score) <= s.drawScore ? drawStreak + 1 : 0;
+			if(s.drawMoves > 0 && drawStreak >= s.drawMoves)
+			{
+				reason = END_DRAW_SCORE;
+				return false;
+			}
+
+			// 시간 제한이 너무 짧아서 깊이 1도 못 끝냈으면 아무 수나 둠
+			if(!result.hasMove)
+			{
+				ChessMove moves[MAX_MOVES];
+				engine.generateMoves(moves);
+				result.bestMove = moves[0];
+			}
+			engine.playMove(result.bestMove);
+		}
+	}
+};
@@ -0,0 +1,487 @@
+#pragma once
+
+//
+// FEN, EPD, SAN, PGN 표기법을 엔진 포지션/수로 바꾸는 함수들.
+//
+// 엔진 좌표는 y = 0이 8랭크이고 판 문자는 대문자가 흑이라서, 대문자가 백인 FEN과는 대소문자가 반대임.
+// 엔진이 앙파상과 프로모션을 지원하지 않기 때문에 앙파상 칸은 읽기만 하고 무시하며,
+// 프로모션 수(e8=Q 등)는 엔진의 어떤 수와도 맞지 않아서 읽을 수 없음.
+//
+
+#include <ctype.h>
+#include <istream>
+#include <string>
+#include <vector>
+
+
+const char* const START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+
+const char* skipSpaces(const char* text)
+{
+	while(*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n') text++;
+	return text;
+}
+
+
+/**
+ * 공백이나 stop 문자 전까지를 token에 넣음.
+ * @return 읽고 난 다음 위치
+ */
+const char* readToken(const char* text, std::string& token, char stop = '\0')
+{
+	token.clear();
+	text = skipSpaces(text);
+	while(*text != '\0' && *text != ' ' && *text != '\t' && *text != '\r' && *text != '\n' && *text != stop)
+	{
+		token += *text++;
+	}
+	return text;
+}
+
+
+std::string squareName(int x, int y)
+{
+	std::string name;
+	name += (char) ('a' + x);
+	name += (char) ('8' - y);
+	return name;
+}
+
+
+/**
+ * FEN의 앞 네 필드(배치, 차례, 캐슬링, 앙파상)를 읽음. 뒤에 halfmove/fullmove 숫자가 있으면 같이 읽고 무시함.
+ * 캐슬링 권리는 킹과 룩의 didMove로 바꿔서 movedMask에 넣음. (권리가 없는 쪽의 킹/룩은 움직인 적 있는 것으로 봄)
+ * @param rest nullptr가 아니면 읽고 남은 부분(EPD 연산)의 시작 위치를 넣음
+ * @return 형식이 맞지 않으면 false
+ */
+bool parseFen(const char* fen, ChessPosition& position, const char** rest = nullptr)
+{
+	std::string placement, turn, castling, enPassant;
+	fen = readToken(fen, placement);
+	fen = readToken(fen, turn);
+	fen = readToken(fen, castling);
+	fen = readToken(fen, enPassant);
+	if(placement.empty() || (turn != "w" && turn != "b") || castling.empty() || enPassant.empty()) return false;
+
+	memset(position.board, ' ', 64);
+	int x = 0, y = 0;
+	for(char c : placement)
+	{
+		if(c == '/')
+		{
+			if(x != 8) return false;
+			x = 0; y++;
+		}
+		else if(c >= '1' && c <= '8') x += c - '0';
+		else if(strchr("PNBRQKpnbrqk", c) != nullptr && x < 8 && y < 8)
+		{
+			// FEN은 대문자가 백이라서 엔진 형식으로 바꾸려면 대소문자를 뒤집어야 함
+			position.board[y * 8 + x++] = c ^ 0b00100000;
+		}
+		else return false;
+		if(x > 8) return false;
+	}
+	if(x != 8 || y != 7) return false;
+	position.turn = turn == "w" ? PieceColor::WHITE : PieceColor::BLACK;
+
+	position.movedMask = 0;
+	for(int i = 0; i < 64; i++)
+	{
+		char type = position.board[i] & 0b01011111;
+		if(type == 'K' || type == 'R') position.movedMask |= 1ULL << i;
+	}
+	// 권리 문자 -> 움직이지 않은 것으로 볼 킹 자리, 룩 자리
+	const int white = ColorTraits<PieceColor::WHITE>::backRank * 8, black = ColorTraits<PieceColor::BLACK>::backRank * 8;
+	for(char c : castling)
+	{
+		int kingSquare, rookSquare;
+		switch(c)
+		{
+			case 'K': kingSquare = white + 4; rookSquare = white + 7; break;
+			case 'Q': kingSquare = white + 4; rookSquare = white + 0; break;
+			case 'k': kingSquare = black + 4; rookSquare = black + 7; break;
+			case 'q': kingSquare = black + 4; rookSquare = black + 0; break;
+			case '-': continue;
+			default: return false;
+		}
+		position.movedMask &= ~(1ULL << kingSquare | 1ULL << rookSquare);
+	}
+
+	// halfmove/fullmove 필드는 숫자일 때만 읽음 (EPD에서는 바로 연산이 나옴)
+	for(int i = 0; i < 2; i++)
+	{
+		std::string number;
+		const char* next = readToken(fen, number);
+		if(number.empty() || !isdigit((unsigned char) number[0])) break;
+		fen = next;
+	}
+	if(rest != nullptr) *rest = skipSpaces(fen);
+	return true;
+}
+
+
+/**
+ * position을 FEN으로 바꿈. 앙파상 칸은 항상 "-"이고, halfmove/fullmove는 "0 1"로 씀.
+ */
+std::string formatFen(const ChessPosition& position)
+{
+	std::string fen;
+	for(int y = 0; y < 8; y++)
+	{
+		int empty = 0;
+		for(int x = 0; x < 8; x++)
+		{
+			char c = position.board[y * 8 + x];
+			if(c == ' ')
+			{
+				empty++;
+				continue;
+			}
+			if(empty > 0) fen += (char) ('0' + empty);
+			empty = 0;
+			fen += (char) (c ^ 0b00100000);
+		}
+		if(empty > 0) fen += (char) ('0' + empty);
+		if(y != 7) fen += '/';
+	}
+	fen += position.turn == PieceColor::WHITE ? " w " : " b ";
+
+	// 킹과 룩이 처음 자리에 있고 움직인 적이 없을 때만 권리가 있음
+	auto unmoved = [&](int square, char c) {
+		return position.board[square] == c && (position.movedMask >> square & 1) == 0;
+	};
+	const int white = ColorTraits<PieceColor::WHITE>::backRank * 8, black = ColorTraits<PieceColor::BLACK>::backRank * 8;
+	std::string castling;
+	if(unmoved(white + 4, 'k') && unmoved(white + 7, 'r')) castling += 'K';
+	if(unmoved(white + 4, 'k') && unmoved(white + 0, 'r')) castling += 'Q';
+	if(unmoved(black + 4, 'K') && unmoved(black + 7, 'R')) castling += 'k';
+	if(unmoved(black + 4, 'K') && unmoved(black + 0, 'R')) castling += 'q';
+	fen += castling.empty() ? "-" : castling;
+	fen += " - 0 1";
+	return fen;
+}
+
+
+/**
+ * move를 SAN으로 바꿈. (체크 표시 +, # 는 붙이지 않음)
+ * @param moves engine에서 지금 둘 수 있는 모든 수 (같은 칸으로 가는 같은 종류의 말을 구분할 때 씀)
+ */
+std::string formatSan(ChessEngine& engine, const ChessMove& move, const ChessMove* moves, int moveCount)
+{
+	ChessPiece* piece = engine.getPieceAt(move.srcX, move.srcY);
+	if(piece->type == PieceType::KING && abs(move.dstX - move.srcX) == 2)
+	{
+		return move.dstX == 6 ? "O-O" : "O-O-O";
+	}
+
+	bool capture = engine.getPieceAt(move.dstX, move.dstY) != nullptr;
+	std::string san;
+	if(piece->type == PieceType::PAWN)
+	{
+		if(capture) san += (char) ('a' + move.srcX);
+	}
+	else
+	{
+		san += static_cast<char>(piece->type);
+
+		// 같은 칸으로 갈 수 있는 같은 종류의 말이 또 있으면 파일, 랭크, 둘 다 순서로 구분함
+		bool ambiguous = false, sameFile = false, sameRank = false;
+		for(int i = 0; i < moveCount; i++)
+		{
+			const ChessMove& other = moves[i];
+			if(other.dstX != move.dstX || other.dstY != move.dstY) continue;
+			if(other.srcX == move.srcX && other.srcY == move.srcY) continue;
+			if(engine.getPieceAt(other.srcX, other.srcY)->type != piece->type) continue;
+			ambiguous = true;
+			if(other.srcX == move.srcX) sameFile = true;
+			if(other.srcY == move.srcY) sameRank = true;
+		}
+		if(ambiguous)
+		{
+			if(!sameFile) san += (char) ('a' + move.srcX);
+			else if(!sameRank) san += (char) ('8' - move.srcY);
+			else san += squareName(move.srcX, move.srcY);
+		}
+	}
+
+	if(capture) san += 'x';
+	san += squareName(move.dstX, move.dstY);
+	return san;
+}
+
+
+std::string formatSan(ChessEngine& engine, const ChessMove& move)
+{
+	ChessMove moves[MAX_MOVES];
+	int moveCount = engine.generateMoves(moves);
+	return formatSan(engine, move, moves, moveCount);
+}
+
+
+/**
+ * SAN(Nf3, exd5, O-O 등) 또는 좌표 표기(g1f3)로 된 수를 읽음.
+ * 모든 수를 만들어보지 않고, 표기에 맞는 말들만 isPieceMovableTo()로 확인하기 때문에 읽은 수는 항상 둘 수 있는 수임.
+ * 필요 없는 구분 표시가 붙은 SAN(Ngf3 등)도 받아줌.
+ * @return 둘 수 있는 수 중에 맞는 게 없거나, 맞는 수가 여러 개라서 구분할 수 없으면 false
+ */
+bool parseMove(ChessEngine& engine, const std::string& text, ChessMove& move)
+{
+	// 체크 표시와 주석 기호는 무시하고, 0-0처럼 숫자로 쓴 캐슬링도 받아줌
+	std::string san = text;
+	while(!san.empty() && strchr("+#!?", san.back()) != nullptr) san.pop_back();
+	for(char& c : san) if(c == '0') c = 'O';
+	if(san.empty()) return false;
+
+	auto isFile = [](char c) { return c >= 'a' && c <= 'h'; };
+	auto isRank = [](char c) { return c >= '1' && c <= '8'; };
+	size_t n = san.size();
+	if(n == 4 && isFile(san[0]) && isRank(san[1]) && isFile(san[2]) && isRank(san[3]))
+	{
+		move.srcX = san[0] - 'a'; move.srcY = '8' - san[1];
+		move.dstX = san[2] - 'a'; move.dstY = '8' - san[3];
+		return engine.isPieceMovableTo(move.srcX, move.srcY, move.dstX, move.dstY, true, true);
+	}
+
+	PieceColor turn = engine.getTurn();
+	if(san == "O-O" || san == "O-O-O")
+	{
+		ChessPiece* king = engine.findPiece(PieceType::KING, turn);
+		if(king == nullptr) return false;
+		move.srcX = king->x; move.srcY = king->y;
+		move.dstX = san == "O-O" ? 6 : 2; move.dstY = king->y;
+		return king->x == 4 && engine.isPieceMovableTo(move.srcX, move.srcY, move.dstX, move.dstY, true, true);
+	}
+
+	// [말][출발 파일][출발 랭크][x]도착 칸
+	if(n < 2 || !isFile(san[n - 2]) || !isRank(san[n - 1])) return false;
+	int dstX = san[n - 2] - 'a', dstY = '8' - san[n - 1];
+	size_t i = 0;
+	char type = static_cast<char>(PieceType::PAWN);
+	if(strchr("NBRQK", san[0]) != nullptr) type = san[i++];
+	int fileHint = -1, rankHint = -1;
+	bool capture = false;
+	for(; i < n - 2; i++)
+	{
+		if(san[i] == 'x' && !capture) capture = true;
+		else if(isFile(san[i]) && fileHint < 0 && !capture) fileHint = san[i] - 'a';
+		else if(isRank(san[i]) && rankHint < 0 && !capture) rankHint = '8' - san[i];
+		else return false;
+	}
+	// 폰은 잡을 때만 파일을 바꾸고, 잡을 때는 출발 파일을 꼭 씀
+	if(type == static_cast<char>(PieceType::PAWN))
+	{
+		if(capture && fileHint < 0) return false;
+		if(!capture && fileHint < 0) fileHint = dstX;
+	}
+
+	int found = 0;
+	for(int y = 0; y < 8; y++)
+	{
+		if(rankHint >= 0 && y != rankHint) continue;
+		for(int x = 0; x < 8; x++)
+		{
+			if(fileHint >= 0 && x != fileHint) continue;
+			ChessPiece* piece = engine.getPieceAt(x, y);
+			if(piece == nullptr || piece->color != turn || static_cast<char>(piece->type) != type) continue;
+			if(!engine.isPieceMovableTo(x, y, dstX, dstY, true, true)) continue;
+			move.srcX = x; move.srcY = y;
+			move.dstX = dstX; move.dstY = dstY;
+			found++;
+		}
+	}
+	return found == 1;
+}
+
+
+struct EpdOperation
+{
+	std::string opcode;
+	std::vector<std::string> operands;
+};
+
+struct EpdRecord
+{
+	ChessPosition position;
+	std::vector<EpdOperation> operations;
+
+	/**
+	 * @return opcode 연산이 없으면 nullptr
+	 */
+	const EpdOperation* find(const char* opcode) const
+	{
+		for(const EpdOperation& operation : this->operations)
+		{
+			if(operation.opcode == opcode) return &operation;
+		}
+		return nullptr;
+	}
+};
+
+
+/**
+ * EPD 한 줄을 읽음. 형식: FEN 앞 네 필드 + "opcode operand ...;" 반복
+ * 따옴표로 감싼 피연산자는 공백과 ;를 포함할 수 있음.
+ * @return 포지션이나 연산의 형식이 맞지 않으면 false
+ */
+bool parseEpd(const char* line, EpdRecord& record)
+{
+	record.operations.clear();
+	if(!parseFen(line, record.position, &line)) return false;
+
+	while(*(line = skipSpaces(line)) != '\0')
+	{
+		EpdOperation operation;
+		line = readToken(line, operation.opcode, ';');
+		if(operation.opcode.empty()) return false;
+
+		while(true)
+		{
+			line = skipSpaces(line);
+			if(*line == ';')
+			{
+				line++;
+				break;
+			}
+			// 마지막 연산은 ;가 빠져 있어도 받아줌
+			if(*line == '\0') break;
+
+			std::string operand;
+			if(*line == '"')
+			{
+				const char* end = strchr(line + 1, '"');
+				if(end == nullptr) return false;
+				operand.assign(line + 1, end);
+				line = end + 1;
+			}
+			else line = readToken(line, operand, ';');
+			operation.operands.push_back(operand);
+		}
+		record.operations.push_back(operation);
+	}
+	return true;
+}
+
+
+struct PgnGame
+{
+	std::string fen;                // FEN 태그. 없으면 빈 문자열 (시작 포지션)
+	std::vector<std::string> moves; // 수 번호, 주석, 변화수, NAG를 뺀 SAN
+	std::string result;             // "1-0", "0-1", "1/2-1/2", "*" 또는 빈 문자열
+};
+
+
+/**
+ * PGN 파일에서 게임을 하나씩 읽는 클래스.
+ * 게임은 다음 태그가 나오거나, 결과 토큰이 나오거나, 수 다음에 빈 줄이 나오면 끝남.
+ * 그래서 태그 없이 한 줄에 게임 하나씩 수만 나열한 파일도 읽을 수 있음.
+ */
+class PgnReader
+{
+public:
+	PgnReader(std::istream& in_)
+		: in(in_), hasPending(false)
+	{}
+
+	/**
+	 * @return 더 읽을 게임이 없으면 false
+	 */
+	bool next(PgnGame& game)
+	{
+		game.fen.clear();
+		game.moves.clear();
+		game.result.clear();
+		bool hasTags = false, hasMoves = false, inComment = false;
+		int variationDepth = 0;
+
+		while(this->hasPending || std::getline(this->in, this->line))
+		{
+			this->hasPending = false;
+			const char* text = skipSpaces(this->line.c_str());
+			bool inMoveText = inComment || variationDepth > 0;
+
+			if(!inMoveText && *text == '[')
+			{
+				// 수 다음에 나온 태그는 다음 게임의 것
+				if(hasMoves)
+				{
+					this->hasPending = true;
+					return true;
+				}
+				hasTags = true;
+				this->readTag(text, game);
+				continue;
+			}
+			if(*text == '\0')
+			{
+				if(hasMoves && !inMoveText) return true;
+				continue;
+			}
+			if(*text == '%') continue;
+
+			while(*(text = skipSpaces(text)) != '\0')
+			{
+				if(inComment)
+				{
+					const char* end = strchr(text, '}');
+					if(end == nullptr) break;
+					inComment = false;
+					text = end + 1;
+				}
+				else if(*text == '{') { inComment = true; text++; }
+				else if(*text == ';') break;
+				else if(*text == '(') { variationDepth++; text++; }
+				else if(*text == ')') { if(variationDepth > 0) variationDepth--; text++; }
+				else
+				{
+					std::string token;
+					while(*text != '\0' && *text != ' ' && *text != '\t' && *text != '\r' && strchr("{;()", *text) == nullptr)
+					{
+						token += *text++;
+					}
+					if(variationDepth > 0) continue;
+					if(token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*")
+					{
+						game.result = token;
+						return true;
+					}
+
+					// "12.", "12...", "12.e4" 같은 수 번호를 떼어냄
+					size_t start = 0, digits = 0;
+					while(digits < token.size() && isdigit((unsigned char) token[digits])) digits++;
+					if(digits < token.size() && token[digits] == '.')
+					{
+						start = digits;
+						while(start < token.size() && token[start] == '.') start++;
+					}
+					if(start == token.size() || token[start] == '$') continue;
+
+					game.moves.push_back(token.substr(start));
+					hasMoves = true;
+				}
+			}
+		}
+		return hasTags || hasMoves;
+	}
+
+private:
+	std::istream& in;
+	std::string line;
+	bool hasPending; // line에 다음 게임의 첫 줄이 들어있음
+
+	/**
+	 * [Name "Value"] 형식의 태그 중에 FEN과 Result만 씀
+	 */
+	void readTag(const char* text, PgnGame& game)
+	{
+		std::string name;
+		text = readToken(text + 1, name);
+		const char* start = strchr(text, '"');
+		if(start == nullptr) return;
+		const char* end = strchr(start + 1, '"');
+		if(end == nullptr) return;
+		std::string value(start + 1, end);
+		if(name == "FEN") game.fen = value;
+		else if(name == "Result" && value != "*") game.result = value;
+	}
+};
@@ -0,0 +1,359 @@
+#pragma once
+
+//
+// 판 상태를 32바이트로 줄여서 저장/전송하기 위한 포맷.
+//
+//   0..7   : 말이 있는 칸의 비트마스크 (비트 y * 8 + x, 리틀 엔디언)
+//   8..23  : 말이 있는 칸 순서대로 말 하나당 4비트 코드 (최대 32개, 앞쪽 말이 하위 니블)
+//   24     : 상태 비트. 0번 비트: 백 차례면 1
+//   25     : 앙파상 파일 + 1 (0이면 없음. 지금 엔진은 앙파상을 지원하지 않아서 항상 0)
+//   26..31 : 예약 (0)
+//
+// 4비트 코드: 3번 비트가 백, 하위 3비트는
+//   0 움직인 적 없는 킹, 1 폰, 2 나이트, 3 비숍, 4 룩, 5 퀸, 6 움직인 적 있는 킹, 7 움직인 적 없는 룩
+// 킹과 룩의 didMove를 말마다 그대로 담기 때문에 캐슬링 가능 여부도 엔진과 똑같이 복원됨.
+//
+// 스트림 파일 포맷:
+//   "CPOS" + 버전(4바이트), 그 다음 블록들이 반복됨.
+//   블록: 포지션 개수(4바이트) + 압축된 데이터 크기(4바이트) + 압축된 데이터
+//   압축: 블록 안에서 각 포지션을 바로 앞 포지션과 XOR한 후, 0이 연속된 부분을 run-length로 줄임.
+//         같은 게임에서 나온 포지션들은 대부분 바이트가 같기 때문에 XOR하면 거의 0이 됨.
+//         제어 바이트가 0x80 미만이면 그 다음 (n + 1)바이트를 그대로, 0x80 이상이면 0을 (n - 0x80 + 1)개 씀.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+
+const int PACKED_POSITION_SIZE = 32;
+
+struct PackedPosition
+{
+	unsigned char bytes[PACKED_POSITION_SIZE];
+};
+
+
+// 판 문자 -> 4비트 코드. 빈 칸이나 알 수 없는 문자는 0xFF
+struct PackTables
+{
+	unsigned char code[256];
+	unsigned char movedXor[256];
+	char symbol[16];
+
+	PackTables()
+	{
+		for(int i = 0; i < 256; i++) { this->code[i] = 0xFF; this->movedXor[i] = 0; }
+		const char types[8] = { 'K', 'P', 'N', 'B', 'R', 'Q', 'K', 'R' };
+		for(int c = 0; c < 16; c++)
+		{
+			this->symbol[c] = types[c & 7] | ((c & 8) ? 0b00100000 : 0);
+		}
+		for(int white = 0; white <= 1; white++)
+		{
+			int colorBit = white ? 8 : 0;
+			int lower = white ? 0b00100000 : 0;
+			this->code['P' | lower] = colorBit | 1;
+			this->code['N' | lower] = colorBit | 2;
+			this->code['B' | lower] = colorBit | 3;
+			this->code['Q' | lower] = colorBit | 5;
+			this->code['K' | lower] = colorBit | 0; this->movedXor['K' | lower] = 0 ^ 6;
+			this->code['R' | lower] = colorBit | 7; this->movedXor['R' | lower] = 7 ^ 4;
+		}
+	}
+};
+
+const PackTables PACK_TABLES;
+
+
+/**
+ * position을 32바이트로 압축함.
+ * @return 말이 32개보다 많아서 담을 수 없으면 false
+ */
+bool packPosition(const ChessPosition& position, PackedPosition& packed)
+{
+	unsigned char codes[64];
+	unsigned long long occupancy = 0;
+	int count = 0;
+	for(int i = 0; i < 64; i++)
+	{
+		unsigned char c = position.board[i];
+		unsigned char code = PACK_TABLES.code[c];
+		unsigned long long isPiece = code != 0xFF;
+		code ^= PACK_TABLES.movedXor[c] & -(unsigned char) (position.movedMask >> i & 1);
+		occupancy |= isPiece << i;
+		// 빈 칸이면 같은 자리에 다음 말이 덮어쓰기 때문에 분기 없이 쓸 수 있음
+		codes[count] = code;
+		count += isPiece;
+	}
+	if(count > 32) return false;
+
+	memset(packed.bytes, 0, PACKED_POSITION_SIZE);
+	for(int b = 0; b < 8; b++) packed.bytes[b] = occupancy >> (8 * b);
+	for(int i = 0; i < count; i++) packed.bytes[8 + i / 2] |= codes[i] << (4 * (i & 1));
+	packed.bytes[24] = position.turn == PieceColor::WHITE;
+	return true;
+}
+
+
+void unpackPosition(const PackedPosition& packed, ChessPosition& position)
+{
+	unsigned long long occupancy = 0;
+	for(int b = 0; b < 8; b++) occupancy |= (unsigned long long) packed.bytes[b] << (8 * b);
+
+	memset(position.board, ' ', 64);
+	position.movedMask = 0;
+	for(int i = 0; occupancy != 0; i++, occupancy &= occupancy - 1)
+	{
+		int square = __builtin_ctzll(occupancy);
+		int code = packed.bytes[8 + i / 2] >> (4 * (i & 1)) & 0xF;
+		position.board[square] = PACK_TABLES.symbol[code];
+		// 하위 3비트가 4(움직인 룩) 또는 6(움직인 킹)이면 움직인 적 있음
+		unsigned long long moved = (code & 5) == 4;
+		position.movedMask |= moved << square;
+	}
+	position.turn = packed.bytes[24] & 1 ? PieceColor::WHITE : PieceColor::BLACK;
+}
+
+
+bool packEngine(ChessEngine& engine, PackedPosition& packed)
+{
+	ChessPosition position;
+	engine.getPosition(position);
+	return packPosition(position, packed);
+}
+
+
+void unpackEngine(const PackedPosition& packed, ChessEngine& engine)
+{
+	ChessPosition position;
+	unpackPosition(packed, position);
+	engine.setPosition(position);
+}
+
+
+const char PACKED_FILE_MAGIC[4] = { 'C', 'P', 'O', 'S' };
+const unsigned int PACKED_FILE_VERSION = 1;
+
+
+void writeUint32(FILE* file, unsigned int value)
+{
+	unsigned char bytes[4] = {
+		(unsigned char) value, (unsigned char) (value >> 8), (unsigned char) (value >> 16), (unsigned char) (value >> 24)
+	};
+	fwrite(bytes, 1, 4, file);
+}
+
+
+bool readUint32(FILE* file, unsigned int& value)
+{
+	unsigned char bytes[4];
+	if(fread(bytes, 1, 4, file) != 4) return false;
+	value = bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (unsigned int) bytes[3] << 24;
+	return true;
+}
+
+
+/**
+ * PackedPosition들을 블록 단위로 압축해서 파일에 쓰는 클래스.
+ */
+class PackedPositionWriter
+{
+public:
+	static const int BLOCK_SIZE = 4096;
+
+	PackedPositionWriter()
+		: file(nullptr), totalPositions(0), totalBytes(0)
+	{}
+
+	~PackedPositionWriter()
+	{
+		this->close();
+	}
+
+	bool open(const char* path)
+	{
+		this->file = fopen(path, "wb");
+		if(this->file == nullptr) return false;
+		fwrite(PACKED_FILE_MAGIC, 1, 4, this->file);
+		writeUint32(this->file, PACKED_FILE_VERSION);
+		this->totalBytes = 8;
+		return true;
+	}
+
+	void write(const PackedPosition& packed)
+	{
+		this->block.push_back(packed);
+		if((int) this->block.size() == BLOCK_SIZE) this->flush();
+	}
+
+	/**
+	 * 남은 블록을 쓰고 파일을 닫음.
+	 */
+	void close()
+	{
+		if(this->file == nullptr) return;
+		this->flush();
+		fclose(this->file);
+		this->file = nullptr;
+	}
+
+	unsigned long long getPositionCount() { return this->totalPositions; }
+	unsigned long long getByteCount() { return this->totalBytes; }
+
+private:
+	FILE* file;
+	std::vector<PackedPosition> block;
+	std::vector<unsigned char> compressed;
+	unsigned long long totalPositions, totalBytes;
+
+	void flush()
+	{
+		if(this->block.empty()) return;
+
+		this->compressed.clear();
+		unsigned char prev[PACKED_POSITION_SIZE] = { 0 };
+		unsigned char literal[128];
+		int literalCount = 0, zeroCount = 0;
+
+		for(const PackedPosition& packed : this->block)
+		{
+			for(int i = 0; i < PACKED_POSITION_SIZE; i++)
+			{
+				unsigned char delta = packed.bytes[i] ^ prev[i];
+				prev[i] = packed.bytes[i];
+
+				if(delta == 0)
+				{
+					this->flushLiteral(literal, literalCount);
+					if(++zeroCount == 128) this->flushZeros(zeroCount);
+				}
+				else
+				{
+					this->flushZeros(zeroCount);
+					literal[literalCount++] = delta;
+					if(literalCount == 128) this->flushLiteral(literal, literalCount);
+				}
+			}
+		}
+		this->flushLiteral(literal, literalCount);
+		this->flushZeros(zeroCount);
+
+		writeUint32(this->file, this->block.size());
+		writeUint32(this->file, this->compressed.size());
+		fwrite(this->compressed.data(), 1, this->compressed.size(), this->file);
+
+		this->totalPositions += this->block.size();
+		this->totalBytes += 8 + this->compressed.size();
+		this->block.clear();
+	}
+
+	void flushLiteral(unsigned char* literal, int& count)
+	{
+		if(count == 0) return;
+		this->compressed.push_back(count - 1);
+		this->compressed.insert(this->compressed.end(), literal, literal + count);
+		count = 0;
+	}
+
+	void flushZeros(int& count)
+	{
+		if(count == 0) return;
+		this->compressed.push_back(0x80 + count - 1);
+		count = 0;
+	}
+};
+
+
+/**
+ * PackedPositionWriter로 쓴 파일을 블록 단위로 읽는 클래스.
+ */
+class PackedPositionReader
+{
+public:
+	PackedPositionReader()
+		: file(nullptr), index(0)
+	{}
+
+	~PackedPositionReader()
+	{
+		if(this->file != nullptr) fclose(this->file);
+	}
+
+	/**
+	 * @return 파일이 없거나 형식이 맞지 않으면 false
+	 */
+	bool open(const char* path)
+	{
+		this->file = fopen(path, "rb");
+		if(this->file == nullptr) return false;
+
+		char magic[4];
+		unsigned int version;
+		if(fread(magic, 1, 4, this->file) != 4 || memcmp(magic, PACKED_FILE_MAGIC, 4) != 0) return false;
+		if(!readUint32(this->file, version) || version != PACKED_FILE_VERSION) return false;
+		return true;
+	}
+
+	/**
+	 * @return 더 읽을 포지션이 없거나 파일이 깨져있으면 false
+	 */
+	bool read(PackedPosition& packed)
+	{
+		if(this->index == this->block.size() && !this->readBlock()) return false;
+		packed = this->block[this->index++];
+		return true;
+	}
+
+private:
+	FILE* file;
+	std::vector<PackedPosition> block;
+	std::vector<unsigned char> compressed;
+	size_t index;
+
+	bool readBlock()
+	{
+		unsigned int count, size;
+		if(this->file == nullptr || !readUint32(this->file, count) || !readUint32(this->file, size)) return false;
+		// 깨진 헤더로 큰 버퍼를 잡거나 크기 계산이 넘치지 않게, 라이터가 쓸 수 있는 크기만 받음.
+		// 압축 결과는 최악의 경우(0이 아닌 바이트와 0이 번갈아 나올 때)에도 원래 크기의 1.5배를 넘지 않음
+		if(count > (unsigned int) PackedPositionWriter::BLOCK_SIZE) return false;
+		if(size > (size_t) PackedPositionWriter::BLOCK_SIZE * PACKED_POSITION_SIZE * 2) return false;
+		this->compressed.resize(size);
+		if(fread(this->compressed.data(), 1, size, this->file) != size) return false;
+
+		std::vector<unsigned char> bytes((size_t) count * PACKED_POSITION_SIZE);
+		size_t out = 0;
+		for(size_t in = 0; in < size; )
+		{
+			unsigned char control = this->compressed[in++];
+			size_t length = (control & 0x7F) + 1;
+			if(out + length > bytes.size()) return false;
+			if(control & 0x80)
+			{
+				memset(&bytes[out], 0, length);
+			}
+			else
+			{
+				if(in + length > size) return false;
+				memcpy(&bytes[out], &this->compressed[in], length);
+				in += length;
+			}
+			out += length;
+		}
+		if(out != bytes.size()) return false;
+
+		this->block.resize(count);
+		unsigned char prev[PACKED_POSITION_SIZE] = { 0 };
+		for(unsigned int p = 0; p < count; p++)
+		{
+			for(int i = 0; i < PACKED_POSITION_SIZE; i++)
+			{
+				prev[i] ^= bytes[(size_t) p * PACKED_POSITION_SIZE + i];
+				this->block[p].bytes[i] = prev[i];
+			}
+		}
+		this->index = 0;
+		return count > 0;
+	}
+};
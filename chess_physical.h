@@ -4,4 +4,17 @@ void movePhysicalPieceTo(int srcX, int srcY, int dstX, int dstY)
 {}
 
 void killPhysicalPieceAt(int x, int y)
+{}
+
+/**
+ * killPhysicalPieceAt()으로 가장 마지막에 치운 말을 (x, y)에 다시 놓는 함수. (수를 되돌릴 때)
+ */
+void revivePhysicalPieceAt(int x, int y)
+{}
+
+/**
+ * 캐리지를 반 칸 단위 좌표 (halfX, halfY)까지 직선으로 움직이는 함수.
+ * magnetOn이 true면 자석을 켜서 위에 있는 말을 끌고 감.
+ */
+void movePhysicalCarriageTo(int halfX, int halfY, bool magnetOn)
 {}
\ No newline at end of file
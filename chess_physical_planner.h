@@ -0,0 +1,323 @@
+#pragma once
+
+//
+// 엔진의 한 수를 물리 체스판 캐리지(판 밑에서 자석으로 말을 끄는 장치)의 이동 구간 목록으로 바꿔주는 플래너.
+//
+// 좌표는 반 칸 단위를 씀. 칸 (x, y)의 중심은 (2x+1, 2y+1)이고, 짝수 좌표는 칸과 칸 사이의 선임.
+// 말은 칸 사이의 선을 따라 다른 말 옆을 지나갈 수 있다고 가정하고, 말이 있는 칸의 중심만 지나가지 못함.
+// 잡힌 말은 판 양 옆의 무덤 칸(흑은 x < 0, 백은 x >= 8)으로 옮기고, 수를 되돌리면 가장 마지막에 잡힌 말부터 다시 가져옴.
+//
+
+#include <queue>
+#include <vector>
+#include <math.h>
+
+
+enum class PhysicalSegmentType : char
+{
+	TRAVEL, // 자석을 끈 채로 캐리지만 이동
+	CARRY   // 자석을 켜고 말을 끌고 이동
+};
+
+struct PhysicalSegment
+{
+	PhysicalSegmentType type;
+	signed char fromX, fromY, toX, toY; // 반 칸 단위
+};
+
+
+/**
+ * 엔진의 한 수에 대한 정보. 판 상태는 수를 두기 전 기준.
+ */
+struct PhysicalMoveRequest
+{
+	bool occupied[8][8];
+	int srcX, srcY, dstX, dstY;
+	bool capture;
+	bool capturedIsWhite;
+	int rookSrcX, rookDstX; // 캐슬링이 아니면 -1
+	bool restoreCaptured;   // 되돌리는 수: 말을 옮긴 후 무덤에서 마지막으로 잡힌 말을 (srcX, srcY)에 다시 가져옴
+};
+
+
+/**
+ * 수 하나의 계획. 구간 수는 경로에 따라 정해지지 않으므로 vector에 담음.
+ * (같은 PhysicalPlan을 계속 다시 쓰면 이전 수에서 늘어난 용량을 그대로 씀)
+ */
+struct PhysicalPlan
+{
+	std::vector<PhysicalSegment> segments;
+	double travelSquares; // 자석을 끈 채로 움직인 거리 (칸)
+	double carrySquares;  // 말을 끌고 움직인 거리 (칸)
+	double seconds;       // 예상 소요 시간
+};
+
+
+class PhysicalPlanner
+{
+public:
+	// 무덤은 색깔마다 판 옆에 GRAVEYARD_COLUMNS줄씩 있음
+	static const int GRAVEYARD_COLUMNS = 3;
+	static const int MIN_X = -2 * GRAVEYARD_COLUMNS, MAX_X = 16 + 2 * GRAVEYARD_COLUMNS;
+	static const int GRID_W = MAX_X - MIN_X + 1, GRID_H = 17;
+
+	/**
+	 * @param squaresPerSecond_ 캐리지가 한 축으로 1초에 움직이는 칸 수. 두 축은 동시에 움직임.
+	 * @param magnetSeconds_ 말을 한 번 집고 놓는 데 드는 시간
+	 */
+	PhysicalPlanner(double squaresPerSecond_, double magnetSeconds_)
+		: squaresPerSecond(squaresPerSecond_), magnetSeconds(magnetSeconds_)
+	{
+		this->reset();
+	}
+
+	/**
+	 * 무덤을 비우고 캐리지를 원점에 둠. 실제 판을 정리했을 때 부를 것.
+	 */
+	void reset()
+	{
+		for(int i = 0; i < GRAVEYARD_COLUMNS * 8; i++) this->blackGraveyard[i] = this->whiteGraveyard[i] = 0;
+		this->capturedSlots.clear();
+		this->carriageX = 0;
+		this->carriageY = 0;
+	}
+
+	void plan(const PhysicalMoveRequest& request, PhysicalPlan& plan)
+	{
+		this->clearPlan(plan);
+		for(int y = 0; y < 8; y++) for(int x = 0; x < 8; x++) this->occupied[y][x] = request.occupied[y][x];
+
+		// 잡힌 말은 무조건 가장 먼저 치워야 함
+		if(request.capture)
+		{
+			int slotX, slotY;
+			this->takeGraveyardSlot(request.capturedIsWhite, request.dstX, request.dstY, slotX, slotY);
+			this->carry(plan, 2 * request.dstX + 1, 2 * request.dstY + 1, slotX, slotY);
+			this->occupied[request.dstY][request.dstX] = false;
+		}
+
+		if(request.rookSrcX < 0)
+		{
+			this->carryPiece(plan, request.srcX, request.srcY, request.dstX, request.dstY);
+		}
+		else
+		{
+			// 캐슬링: 킹을 먼저 옮길지 룩을 먼저 옮길지 둘 다 계획해보고 짧은 쪽을 고름
+			PhysicalPlan kingFirst = plan, rookFirst = plan;
+			int startX = this->carriageX, startY = this->carriageY;
+			bool before[8][8];
+			for(int y = 0; y < 8; y++) for(int x = 0; x < 8; x++) before[y][x] = this->occupied[y][x];
+
+			this->carryPiece(kingFirst, request.srcX, request.srcY, request.dstX, request.dstY);
+			this->carryPiece(kingFirst, request.rookSrcX, request.srcY, request.rookDstX, request.srcY);
+			int kingFirstX = this->carriageX, kingFirstY = this->carriageY;
+
+			this->carriageX = startX; this->carriageY = startY;
+			for(int y = 0; y < 8; y++) for(int x = 0; x < 8; x++) this->occupied[y][x] = before[y][x];
+			this->carryPiece(rookFirst, request.rookSrcX, request.srcY, request.rookDstX, request.srcY);
+			this->carryPiece(rookFirst, request.srcX, request.srcY, request.dstX, request.dstY);
+
+			if(kingFirst.seconds < rookFirst.seconds)
+			{
+				plan = kingFirst;
+				this->carriageX = kingFirstX; this->carriageY = kingFirstY;
+			}
+			else plan = rookFirst;
+		}
+
+		if(request.restoreCaptured) this->restoreCaptured(plan, request.srcX, request.srcY);
+	}
+
+private:
+	double squaresPerSecond, magnetSeconds;
+	// 무덤 칸마다 놓인 말 수 (가득 차면 겹쳐 놓기 때문에 2 이상일 수 있음)
+	unsigned char blackGraveyard[GRAVEYARD_COLUMNS * 8], whiteGraveyard[GRAVEYARD_COLUMNS * 8];
+	// 잡힌 순서대로 말을 놓은 무덤 칸. 백 무덤이면 GRAVEYARD_COLUMNS * 8을 더함
+	std::vector<int> capturedSlots;
+	bool occupied[8][8];
+	int carriageX, carriageY;
+
+	void clearPlan(PhysicalPlan& plan)
+	{
+		plan.segments.clear();
+		plan.travelSquares = plan.carrySquares = plan.seconds = 0;
+	}
+
+	/**
+	 * 색깔에 맞는 무덤에서 (x, y)와 가장 가까운 빈 칸을 골라 차지함.
+	 * 무덤이 가득 찼다면 가장 가까운 칸에 겹쳐 놓음.
+	 */
+	void takeGraveyardSlot(bool white, int x, int y, int& slotX, int& slotY)
+	{
+		unsigned char* graveyard = white ? this->whiteGraveyard : this->blackGraveyard;
+		int best = -1, bestAny = 0;
+		double bestDist = 1e9, bestAnyDist = 1e9;
+		for(int i = 0; i < GRAVEYARD_COLUMNS * 8; i++)
+		{
+			int column = i / 8, row = i % 8;
+			int sx = white ? 8 + column : -1 - column;
+			double dist = hypot(sx - x, row - y);
+			if(dist < bestAnyDist) { bestAnyDist = dist; bestAny = i; }
+			if(graveyard[i] == 0 && dist < bestDist) { bestDist = dist; best = i; }
+		}
+		if(best < 0) best = bestAny;
+		graveyard[best]++;
+		this->capturedSlots.push_back(white ? GRAVEYARD_COLUMNS * 8 + best : best);
+		this->getGraveyardSlotCenter(white, best, slotX, slotY);
+	}
+
+	void getGraveyardSlotCenter(bool white, int slot, int& slotX, int& slotY)
+	{
+		int column = slot / 8, row = slot % 8;
+		slotX = 2 * (white ? 8 + column : -1 - column) + 1;
+		slotY = 2 * row + 1;
+	}
+
+	/**
+	 * 가장 마지막에 잡힌 말을 무덤에서 꺼내 (x, y)로 끌고 오고 그 무덤 칸을 비움.
+	 * 잡힌 말이 없으면 (무덤을 reset()한 후 등) 아무것도 하지 않음.
+	 */
+	void restoreCaptured(PhysicalPlan& plan, int x, int y)
+	{
+		if(this->capturedSlots.empty()) return;
+		int slot = this->capturedSlots.back();
+		this->capturedSlots.pop_back();
+		bool white = slot >= GRAVEYARD_COLUMNS * 8;
+		if(white) slot -= GRAVEYARD_COLUMNS * 8;
+		(white ? this->whiteGraveyard : this->blackGraveyard)[slot]--;
+
+		int slotX, slotY;
+		this->getGraveyardSlotCenter(white, slot, slotX, slotY);
+		this->carry(plan, slotX, slotY, 2 * x + 1, 2 * y + 1);
+		this->occupied[y][x] = true;
+	}
+
+	void carryPiece(PhysicalPlan& plan, int srcX, int srcY, int dstX, int dstY)
+	{
+		this->carry(plan, 2 * srcX + 1, 2 * srcY + 1, 2 * dstX + 1, 2 * dstY + 1);
+		this->occupied[srcY][srcX] = false;
+		this->occupied[dstY][dstX] = true;
+	}
+
+	/**
+	 * 캐리지를 (fromX, fromY)로 보낸 후, 그 자리의 말을 (toX, toY)까지 장애물을 피해서 끌고 감. (반 칸 단위)
+	 */
+	void carry(PhysicalPlan& plan, int fromX, int fromY, int toX, int toY)
+	{
+		if(fromX != this->carriageX || fromY != this->carriageY)
+		{
+			this->addSegment(plan, PhysicalSegmentType::TRAVEL, this->carriageX, this->carriageY, fromX, fromY);
+		}
+
+		std::vector<int> path = this->findPath(fromX, fromY, toX, toY);
+
+		// 같은 방향으로 가는 단계들은 한 구간으로 묶음
+		int segStart = 0;
+		for(int i = 1; i < (int) path.size(); i++)
+		{
+			bool last = i + 1 == (int) path.size();
+			if(!last && this->direction(path[i - 1], path[i]) == this->direction(path[i], path[i + 1])) continue;
+			this->addSegment(plan, PhysicalSegmentType::CARRY,
+				path[segStart] % GRID_W + MIN_X, path[segStart] / GRID_W,
+				path[i] % GRID_W + MIN_X, path[i] / GRID_W);
+			segStart = i;
+		}
+
+		plan.seconds += this->magnetSeconds;
+		this->carriageX = toX;
+		this->carriageY = toY;
+	}
+
+	void addSegment(PhysicalPlan& plan, PhysicalSegmentType type, int fromX, int fromY, int toX, int toY)
+	{
+		double dx = (toX - fromX) / 2.0, dy = (toY - fromY) / 2.0;
+		double length = sqrt(dx * dx + dy * dy);
+		double axisMax = fabs(dx) > fabs(dy) ? fabs(dx) : fabs(dy);
+
+		if(type == PhysicalSegmentType::TRAVEL) plan.travelSquares += length;
+		else plan.carrySquares += length;
+		plan.seconds += axisMax / this->squaresPerSecond;
+
+		plan.segments.push_back({ type, (signed char) fromX, (signed char) fromY, (signed char) toX, (signed char) toY });
+	}
+
+	int direction(int from, int to)
+	{
+		return to - from;
+	}
+
+	bool isBlocked(int x, int y)
+	{
+		// 판 위의 칸 중심만 막힐 수 있음 (무덤 칸은 지나가지 않도록 판 밖 중심도 막음)
+		if(x % 2 == 0 || y % 2 == 0) return false;
+		if(x < 0 || x > 16) return true;
+		return this->occupied[y / 2][x / 2];
+	}
+
+	/**
+	 * 반 칸 격자 위에서 8방향으로 움직이는 최단 경로. 방향을 꺾을 때마다 조금씩 비용을 더해서
+	 * 같은 거리라면 꺾는 횟수가 적은 경로를 고름.
+	 * @return 격자 인덱스(y * GRID_W + (x - MIN_X))의 목록. 출발점과 도착점 포함.
+	 */
+	std::vector<int> findPath(int fromX, int fromY, int toX, int toY)
+	{
+		static const int DX[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+		static const int DY[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+		static const int STEP_COST[8] = { 10, 10, 10, 10, 14, 14, 14, 14 };
+		const int TURN_COST = 3;
+		const int NODES = GRID_W * GRID_H;
+
+		// 상태 = 칸 * 8 + 들어온 방향
+		std::vector<int> cost(NODES * 8, 1 << 30), prev(NODES * 8, -1);
+		std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> open;
+
+		int start = fromY * GRID_W + (fromX - MIN_X), goal = toY * GRID_W + (toX - MIN_X);
+		for(int d = 0; d < 8; d++)
+		{
+			cost[start * 8 + d] = 0;
+			open.push({ 0, start * 8 + d });
+		}
+
+		int found = -1;
+		while(!open.empty())
+		{
+			std::pair<int, int> top = open.top();
+			open.pop();
+			int state = top.second;
+			if(top.first != cost[state]) continue;
+			int node = state / 8, dir = state % 8;
+			if(node == goal) { found = state; break; }
+
+			int x = node % GRID_W + MIN_X, y = node / GRID_W;
+			for(int d = 0; d < 8; d++)
+			{
+				int nx = x + DX[d], ny = y + DY[d];
+				if(nx < MIN_X || nx > MAX_X || ny < 0 || ny >= GRID_H) continue;
+				int next = ny * GRID_W + (nx - MIN_X);
+				if(next != goal && this->isBlocked(nx, ny)) continue;
+
+				int nextCost = top.first + STEP_COST[d] + (d == dir || node == start ? 0 : TURN_COST);
+				int nextState = next * 8 + d;
+				if(nextCost >= cost[nextState]) continue;
+				cost[nextState] = nextCost;
+				prev[nextState] = state;
+				open.push({ nextCost, nextState });
+			}
+		}
+
+		std::vector<int> path;
+		if(found < 0)
+		{
+			// 길이 없으면 (말이 꽉 막혀있으면) 그냥 직선으로 끌고 감
+			path.push_back(start);
+			path.push_back(goal);
+			return path;
+		}
+		for(int state = found; state >= 0; state = prev[state]) path.push_back(state / 8);
+		for(int i = 0, j = path.size() - 1; i < j; i++, j--)
+		{
+			int temp = path[i]; path[i] = path[j]; path[j] = temp;
+		}
+		return path;
+	}
+};
@@ -0,0 +1,274 @@
+#pragma once
+
+//
+// 물리 체스판 구동을 게임 루프와 분리하는 비동기 명령 큐.
+// 엔진 스레드가 명령을 넣으면(submit) 전용 스레드가 하나씩 꺼내서 액추에이터로 실행함.
+// 실제 모터는 한 수에 몇 초씩 걸리기 때문에, 엔진은 명령을 넣기만 하고 바로 다음으로 넘어감.
+// 명령을 넣고 나면 결과를 기다리지 않으므로(fire-and-forget), movePieceTo() 등은 하드웨어가 실패해도 알 수 없음.
+// 실패한 명령 수는 getFailedCount()로 따로 확인해야 함.
+//
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include "chess_physical.h"
+#include "chess_physical_planner.h"
+
+
+// PhysicalPlanner의 구간. 좌표는 반 칸 단위
+enum class PhysicalCommandType : char
+{
+	TRAVEL, CARRY
+};
+
+struct PhysicalCommand
+{
+	PhysicalCommandType type;
+	signed char srcX, srcY, dstX, dstY;
+	unsigned int id;
+};
+
+
+/**
+ * 명령을 실제로 실행하는 백엔드. execute()는 PhysicalBoard의 전용 스레드에서만 불림.
+ */
+class PhysicalActuator
+{
+public:
+	virtual ~PhysicalActuator() {}
+
+	/**
+	 * @return 명령을 성공적으로 실행했으면 true
+	 */
+	virtual bool execute(const PhysicalCommand& command) = 0;
+};
+
+
+/**
+ * chess_physical.h의 함수들을 그대로 부르는 액추에이터. (실제 하드웨어용)
+ */
+class DirectActuator : public PhysicalActuator
+{
+public:
+	bool execute(const PhysicalCommand& command)
+	{
+		movePhysicalCarriageTo(command.dstX, command.dstY, command.type == PhysicalCommandType::CARRY);
+		return true;
+	}
+};
+
+
+/**
+ * 하드웨어 없이 파이프라인을 테스트하기 위한 가상 액추에이터.
+ * 말을 집고(grab), 칸 단위로 옮기고(perSquare), 내려놓는(release) 시간만큼 기다림.
+ * 구간은 두 축이 동시에 움직인다고 보고, CARRY가 시작될 때 집고 끝날 때 놓음.
+ */
+class SimulatedActuator : public PhysicalActuator
+{
+public:
+	std::atomic<unsigned long long> executedCount, busyMicros;
+
+	SimulatedActuator(int grabMicros_, int microsPerSquare_, int releaseMicros_)
+		: executedCount(0), busyMicros(0),
+		  grabMicros(grabMicros_), microsPerSquare(microsPerSquare_), releaseMicros(releaseMicros_), carrying(false)
+	{}
+
+	bool execute(const PhysicalCommand& command)
+	{
+		bool carry = command.type == PhysicalCommandType::CARRY;
+		if(carry && !this->carrying) this->wait(this->grabMicros);
+		if(!carry && this->carrying) this->wait(this->releaseMicros);
+		this->carrying = carry;
+
+		int dx = command.dstX - command.srcX, dy = command.dstY - command.srcY;
+		dx = dx < 0 ? -dx : dx;
+		dy = dy < 0 ? -dy : dy;
+		this->wait((dx > dy ? dx : dy) * this->microsPerSquare / 2);
+		this->executedCount++;
+		return true;
+	}
+
+private:
+	int grabMicros, microsPerSquare, releaseMicros;
+	bool carrying;
+
+	void wait(int micros)
+	{
+		if(micros > 0) std::this_thread::sleep_for(std::chrono::microseconds(micros));
+		this->busyMicros += micros;
+	}
+};
+
+
+/**
+ * 생산자 하나, 소비자 하나용 고정 크기 락프리 링 버퍼. Capacity는 2의 거듭제곱이어야 함.
+ */
+template<typename T, unsigned int Capacity>
+class SpscQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	SpscQueue() : head(0), tail(0) {}
+
+	/**
+	 * 생산자 스레드에서만 부를 것.
+	 * @return 큐가 가득 차있으면 false
+	 */
+	bool push(const T& item)
+	{
+		unsigned int t = this->tail.load(std::memory_order_relaxed);
+		if(t - this->head.load(std::memory_order_acquire) == Capacity) return false;
+		this->items[t & (Capacity - 1)] = item;
+		this->tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * 소비자 스레드에서만 부를 것.
+	 * @return 큐가 비어있으면 false
+	 */
+	bool pop(T& item)
+	{
+		unsigned int h = this->head.load(std::memory_order_relaxed);
+		if(h == this->tail.load(std::memory_order_acquire)) return false;
+		item = this->items[h & (Capacity - 1)];
+		this->head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	T items[Capacity];
+	// 생산자와 소비자가 서로 다른 캐시 라인을 건드리도록 떨어뜨려 놓음
+	alignas(64) std::atomic<unsigned int> head;
+	alignas(64) std::atomic<unsigned int> tail;
+};
+
+
+/**
+ * 명령 큐와 그 큐를 비우는 전용 스레드를 묶은 것.
+ * 명령은 넣은 순서대로 실행되고, id도 1부터 순서대로 붙음.
+ * 명령 하나하나의 결과는 남기지 않고, 실패한 명령 수만 셈.
+ * submit()은 한 스레드(엔진 스레드)에서만 불러야 함.
+ */
+class PhysicalBoard
+{
+public:
+	static const unsigned int QUEUE_CAPACITY = 64;
+
+	/**
+	 * @param squaresPerSecond 플래너가 예상 시간을 계산할 때 쓰는 캐리지 속도
+	 * @param magnetSeconds 플래너가 예상 시간을 계산할 때 쓰는, 말 하나를 집고 놓는 데 드는 시간
+	 */
+	PhysicalBoard(PhysicalActuator& actuator_, double squaresPerSecond = 4.0, double magnetSeconds = 0.5)
+		: actuator(actuator_), planner(squaresPerSecond, magnetSeconds),
+		  running(true), submittedId(0), completedId(0), failedCount(0)
+	{
+		this->lastPlan.travelSquares = this->lastPlan.carrySquares = this->lastPlan.seconds = 0;
+		this->worker = std::thread(&PhysicalBoard::drain, this);
+	}
+
+	/**
+	 * 남아있는 명령을 모두 실행한 후 스레드를 멈춤.
+	 */
+	~PhysicalBoard()
+	{
+		this->waitIdle();
+		this->running.store(false, std::memory_order_release);
+		this->worker.join();
+	}
+
+	/**
+	 * 명령을 큐에 넣음. 큐가 가득 차있으면 자리가 날 때까지 기다림.
+	 * @return 명령의 id
+	 */
+	unsigned int submit(PhysicalCommandType type, int srcX, int srcY, int dstX, int dstY)
+	{
+		unsigned int id = this->submittedId.load(std::memory_order_relaxed) + 1;
+		PhysicalCommand command = {
+			type, (signed char) srcX, (signed char) srcY, (signed char) dstX, (signed char) dstY, id
+		};
+		// completedId가 submittedId를 앞지르지 않도록 큐에 넣기 전에 먼저 올려둠
+		this->submittedId.store(id, std::memory_order_release);
+		while(!this->queue.push(command)) std::this_thread::yield();
+		return id;
+	}
+
+	/**
+	 * 엔진의 한 수를 PhysicalPlanner로 구간들로 나눈 후 순서대로 큐에 넣음.
+	 * @return 마지막 구간 명령의 id. 이 id가 끝나면 수 전체가 끝난 것임.
+	 */
+	unsigned int submitMove(const PhysicalMoveRequest& request)
+	{
+		this->planner.plan(request, this->lastPlan);
+		unsigned int id = this->submittedId.load(std::memory_order_relaxed);
+		for(const PhysicalSegment& segment : this->lastPlan.segments)
+		{
+			PhysicalCommandType type = segment.type == PhysicalSegmentType::CARRY ?
+				PhysicalCommandType::CARRY : PhysicalCommandType::TRAVEL;
+			id = this->submit(type, segment.fromX, segment.fromY, segment.toX, segment.toY);
+		}
+		return id;
+	}
+
+	/**
+	 * 가장 최근에 submitMove()로 넣은 수의 계획. (이동 거리, 예상 시간 등)
+	 */
+	const PhysicalPlan& getLastPlan()
+	{
+		return this->lastPlan;
+	}
+
+	void resetPlanner()
+	{
+		this->planner.reset();
+	}
+
+	unsigned int getPendingCount()
+	{
+		return this->submittedId.load(std::memory_order_acquire) - this->completedId.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * 지금까지 액추에이터가 실패한 명령 수. 실패해도 엔진의 판은 이미 바뀌어 있으므로, 늘어났으면 물리 체스판을 확인해야 함.
+	 */
+	unsigned int getFailedCount()
+	{
+		return this->failedCount.load(std::memory_order_acquire);
+	}
+
+	void waitIdle()
+	{
+		while(this->getPendingCount() != 0) std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+
+private:
+	PhysicalActuator& actuator;
+	PhysicalPlanner planner;
+	PhysicalPlan lastPlan;
+	SpscQueue<PhysicalCommand, QUEUE_CAPACITY> queue;
+	std::thread worker;
+	std::atomic<bool> running;
+	std::atomic<unsigned int> submittedId, completedId, failedCount;
+
+	void drain()
+	{
+		PhysicalCommand command;
+		int idleSpins = 0;
+		while(this->running.load(std::memory_order_acquire))
+		{
+			if(!this->queue.pop(command))
+			{
+				// 잠깐은 양보만 하다가, 계속 비어있으면 잠듦
+				if(++idleSpins < 64) std::this_thread::yield();
+				else std::this_thread::sleep_for(std::chrono::microseconds(200));
+				continue;
+			}
+			idleSpins = 0;
+
+			bool ok = this->actuator.execute(command);
+			if(!ok) this->failedCount.fetch_add(1, std::memory_order_relaxed);
+			this->completedId.store(command.id, std::memory_order_release);
+		}
+	}
+};
@@ -0,0 +1,270 @@
+#pragma once
+
+//
+// ChessEngine을 거치지 않고 ChessPosition(값만 있는 판) 위에서 바로 수를 검사하고 두는 함수들.
+//
+// 엔진에 포지션을 불러오면 말 객체를 모두 새로 할당하기 때문에, 게임을 많이 돌리는 곳(세션 호스트 등)에서는
+// 이 함수들로 64바이트 판만 고침. 규칙은 엔진과 똑같음:
+//   - 앙파상과 프로모션은 없음
+//   - 캐슬링은 킹과 룩이 움직인 적 없고(movedMask) 사이가 비어있기만 하면 됨 (지나가는 칸의 체크는 보지 않음)
+//   - 수를 둔 후에 자기 킹이 공격받으면 둘 수 없음
+//
+
+#include <stdlib.h>
+
+
+/**
+ * 판 문자가 백 말인지. 빈 칸(' ')은 먼저 걸러야 함.
+ */
+inline bool isPositionWhite(char c)
+{
+	return (c & 0b00100000) != 0;
+}
+
+
+/**
+ * 판 문자의 말 종류. (대문자)
+ */
+inline char positionPieceType(char c)
+{
+	return c & 0b01011111;
+}
+
+
+/**
+ * (srcX, srcY)와 (dstX, dstY) 사이(양 끝 제외)가 모두 비어있는지. 직선이나 대각선일 때만 부를 것.
+ */
+inline bool isPositionPathClear(const char* board, int srcX, int srcY, int dstX, int dstY)
+{
+	int stepX = dstX > srcX ? 1 : dstX < srcX ? -1 : 0;
+	int stepY = dstY > srcY ? 1 : dstY < srcY ? -1 : 0;
+	for(int x = srcX + stepX, y = srcY + stepY; x != dstX || y != dstY; x += stepX, y += stepY)
+	{
+		if(board[y * 8 + x] != ' ') return false;
+	}
+	return true;
+}
+
+
+/**
+ * (srcX, srcY)의 킹이 (dstX, dstY)로 가는 게 캐슬링이면 같이 움직일 룩의 x좌표. 아니면 -1
+ * (KingPiece::getCastlingVictim()과 같은 조건)
+ */
+inline int getPositionCastlingRookX(const ChessPosition& position, int srcX, int srcY, int dstX, int dstY)
+{
+	if((position.movedMask >> (srcY * 8 + srcX) & 1) != 0 || srcY != dstY) return -1;
+
+	int rookX;
+	if     (dstX == 2) rookX = 0;
+	else if(dstX == 6) rookX = 7;
+	else return -1;
+	if(rookX == srcX || !isPositionPathClear(position.board, srcX, srcY, rookX, srcY)) return -1;
+
+	char king = position.board[srcY * 8 + srcX], rook = position.board[srcY * 8 + rookX];
+	if(rook == ' ' || positionPieceType(rook) != 'R' || isPositionWhite(rook) != isPositionWhite(king)) return -1;
+	if((position.movedMask >> (srcY * 8 + rookX) & 1) != 0) return -1;
+	return rookX;
+}
+
+
+/**
+ * 색깔이 white인 쪽 말이 (x, y)를 잡을 수 있는지. (ChessEngine::calculateCheckmate()와 같은 조건)
+ */
+inline bool isPositionSquareAttacked(const char* board, int x, int y, bool white)
+{
+	auto is = [&](int ax, int ay, char type) {
+		if(ax < 0 || 8 <= ax || ay < 0 || 8 <= ay) return false;
+		char c = board[ay * 8 + ax];
+		return c != ' ' && isPositionWhite(c) == white && positionPieceType(c) == type;
+	};
+
+	// 폰은 (x, y)의 한 칸 뒤쪽 대각선에 있어야 함 (백은 y가 작아지는 쪽으로 전진)
+	int pawnY = white ? y + 1 : y - 1;
+	if(is(x - 1, pawnY, 'P') || is(x + 1, pawnY, 'P')) return true;
+
+	static const int KNIGHT[8][2] = { { 1, 2 }, { 2, 1 }, { 2, -1 }, { 1, -2 }, { -1, -2 }, { -2, -1 }, { -2, 1 }, { -1, 2 } };
+	for(const auto& d : KNIGHT) if(is(x + d[0], y + d[1], 'N')) return true;
+
+	static const int RAYS[8][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+	for(int r = 0; r < 8; r++)
+	{
+		int dx = RAYS[r][0], dy = RAYS[r][1];
+		if(is(x + dx, y + dy, 'K')) return true;
+
+		// 방향마다 처음 만나는 말만 잡을 수 있음
+		for(int ax = x + dx, ay = y + dy; 0 <= ax && ax < 8 && 0 <= ay && ay < 8; ax += dx, ay += dy)
+		{
+			char c = board[ay * 8 + ax];
+			if(c == ' ') continue;
+			char type = positionPieceType(c);
+			if(isPositionWhite(c) == white && (type == 'Q' || type == (r < 4 ? 'R' : 'B'))) return true;
+			break;
+		}
+	}
+	return false;
+}
+
+
+/**
+ * color 쪽 킹이 공격받고 있는지. 킹이 없으면 false. (ChessEngine::isCheckmate()와 같음)
+ */
+inline bool isPositionInCheck(const ChessPosition& position, PieceColor color)
+{
+	bool white = color == PieceColor::WHITE;
+	for(int i = 0; i < 64; i++)
+	{
+		char c = position.board[i];
+		if(c == ' ' || positionPieceType(c) != 'K' || isPositionWhite(c) != white) continue;
+		return isPositionSquareAttacked(position.board, i % 8, i / 8, !white);
+	}
+	return false;
+}
+
+
+/**
+ * 차례인 쪽이 move를 규칙대로 둘 수 있는지. 자기 킹이 공격받게 되는지는 보지 않음.
+ * (ChessEngine::isPieceMovableTo(..., true, false)와 같음)
+ */
+inline bool isPositionMovePseudoLegal(const ChessPosition& position, const ChessMove& move)
+{
+	int srcX = move.srcX, srcY = move.srcY, dstX = move.dstX, dstY = move.dstY;
+	if(srcX == dstX && srcY == dstY) return false;
+	if(srcX < 0 || 8 <= srcX || srcY < 0 || 8 <= srcY) return false;
+	if(dstX < 0 || 8 <= dstX || dstY < 0 || 8 <= dstY) return false;
+
+	char piece = position.board[srcY * 8 + srcX], target = position.board[dstY * 8 + dstX];
+	if(piece == ' ') return false;
+	bool white = isPositionWhite(piece);
+	if(white != (position.turn == PieceColor::WHITE)) return false;
+	if(target != ' ' && isPositionWhite(target) == white) return false;
+
+	int adx = abs(dstX - srcX), ady = abs(dstY - srcY);
+	switch(positionPieceType(piece))
+	{
+		case 'P':
+		{
+			int forward = white ? -1 : 1, homeRank = white ? 6 : 1;
+			if(srcY == homeRank && dstY == srcY + 2 * forward)
+			{
+				return dstX == srcX && target == ' ' && position.board[(srcY + forward) * 8 + srcX] == ' ';
+			}
+			if(dstY - srcY != forward) return false;
+			if(dstX == srcX) return target == ' ';
+			return adx == 1 && target != ' ';
+		}
+		case 'N':
+			return (adx == 1 && ady == 2) || (adx == 2 && ady == 1);
+		case 'B':
+			return adx == ady && isPositionPathClear(position.board, srcX, srcY, dstX, dstY);
+		case 'R':
+			return (adx == 0 || ady == 0) && isPositionPathClear(position.board, srcX, srcY, dstX, dstY);
+		case 'Q':
+			return (adx == ady || adx == 0 || ady == 0) && isPositionPathClear(position.board, srcX, srcY, dstX, dstY);
+		case 'K':
+			return (adx <= 1 && ady <= 1) || getPositionCastlingRookX(position, srcX, srcY, dstX, dstY) >= 0;
+	}
+	return false;
+}
+
+
+/**
+ * 확인하지 않고 수를 둠. 캐슬링이면 룩도 옮기고, 킹과 룩은 움직였다고 표시하고, 차례를 넘김.
+ * (ChessEngine::applyMove()와 같은 결과)
+ */
+inline void applyPositionMove(ChessPosition& position, const ChessMove& move)
+{
+	int src = move.srcY * 8 + move.srcX, dst = move.dstY * 8 + move.dstX;
+	char piece = position.board[src];
+	char type = positionPieceType(piece);
+	int rookX = type == 'K' ? getPositionCastlingRookX(position, move.srcX, move.srcY, move.dstX, move.dstY) : -1;
+
+	position.board[dst] = piece;
+	position.board[src] = ' ';
+	position.movedMask &= ~(1ULL << src | 1ULL << dst);
+	if(type == 'K' || type == 'R') position.movedMask |= 1ULL << dst;
+
+	if(rookX >= 0)
+	{
+		int rookSrc = move.srcY * 8 + rookX, rookDst = move.srcY * 8 + (move.dstX == 2 ? 3 : 5);
+		position.board[rookDst] = position.board[rookSrc];
+		position.board[rookSrc] = ' ';
+		position.movedMask = (position.movedMask & ~(1ULL << rookSrc)) | 1ULL << rookDst;
+	}
+
+	position.turn = position.turn == PieceColor::WHITE ? PieceColor::BLACK : PieceColor::WHITE;
+}
+
+
+/**
+ * move를 둘 수 있으면 position에 두고 true. 둘 수 없으면 position을 건드리지 않고 false.
+ * (ChessEngine::movePieceTo()와 같음)
+ */
+inline bool playPositionMove(ChessPosition& position, const ChessMove& move)
+{
+	if(!isPositionMovePseudoLegal(position, move)) return false;
+	ChessPosition next = position;
+	applyPositionMove(next, move);
+	if(isPositionInCheck(next, position.turn)) return false;
+	position = next;
+	return true;
+}
+
+
+/**
+ * 차례인 쪽이 둘 수 있는 수가 하나라도 있는지. 없으면 체크메이트나 스테일메이트. (ChessEngine::hasLegalMove()와 같음)
+ */
+inline bool hasPositionLegalMove(const ChessPosition& position)
+{
+	static const int KNIGHT[8][2] = { { 1, 2 }, { 2, 1 }, { 2, -1 }, { 1, -2 }, { -1, -2 }, { -2, -1 }, { -2, 1 }, { -1, 2 } };
+	static const int RAYS[8][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+
+	bool white = position.turn == PieceColor::WHITE;
+	ChessPosition next;
+	auto legal = [&](int srcX, int srcY, int dstX, int dstY) {
+		ChessMove move = { (signed char) srcX, (signed char) srcY, (signed char) dstX, (signed char) dstY };
+		if(!isPositionMovePseudoLegal(position, move)) return false;
+		next = position;
+		applyPositionMove(next, move);
+		return !isPositionInCheck(next, position.turn);
+	};
+
+	for(int srcY = 0; srcY < 8; srcY++) for(int srcX = 0; srcX < 8; srcX++)
+	{
+		char piece = position.board[srcY * 8 + srcX];
+		if(piece == ' ' || isPositionWhite(piece) != white) continue;
+
+		switch(positionPieceType(piece))
+		{
+			case 'P':
+			{
+				int forward = white ? -1 : 1;
+				for(int dx = -1; dx <= 1; dx++) if(legal(srcX, srcY, srcX + dx, srcY + forward)) return true;
+				if(legal(srcX, srcY, srcX, srcY + 2 * forward)) return true;
+				break;
+			}
+			case 'N':
+				for(const auto& d : KNIGHT) if(legal(srcX, srcY, srcX + d[0], srcY + d[1])) return true;
+				break;
+			case 'K':
+				for(const auto& d : RAYS) if(legal(srcX, srcY, srcX + d[0], srcY + d[1])) return true;
+				if(legal(srcX, srcY, 2, srcY) || legal(srcX, srcY, 6, srcY)) return true;
+				break;
+			default:
+			{
+				// 슬라이딩 말: 방향마다 막힐 때까지 (막은 말이 상대 말이면 그 칸까지)
+				char type = positionPieceType(piece);
+				for(int r = 0; r < 8; r++)
+				{
+					if((type == 'R' && r >= 4) || (type == 'B' && r < 4)) continue;
+					for(int x = srcX + RAYS[r][0], y = srcY + RAYS[r][1]; 0 <= x && x < 8 && 0 <= y && y < 8;
+						x += RAYS[r][0], y += RAYS[r][1])
+					{
+						if(legal(srcX, srcY, x, y)) return true;
+						if(position.board[y * 8 + x] != ' ') break;
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
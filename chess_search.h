@@ -0,0 +1,290 @@
+#pragma once
+
+//
+// 반복 심화(iterative deepening) 알파베타 탐색.
+// 탐색은 넘겨받은 엔진의 복제본 하나 위에서 playMove()/undo()로 수를 두고 되돌리면서 하기 때문에
+// 원래 엔진은 절대 바뀌지 않음.
+//
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+
+const int SEARCH_MATE_SCORE = 100000;
+const int SEARCH_MAX_PLY = 64;
+
+
+struct SearchLimits
+{
+	int maxDepth;   // 최대 깊이
+	int maxTimeMs;  // 0이면 시간 제한 없음
+};
+
+struct SearchResult
+{
+	bool hasMove;
+	ChessMove bestMove;
+	int score;      // 차례인 쪽 기준 센티폰
+	int depth;      // 끝까지 탐색한 깊이
+	unsigned long long nodes;
+	double ms;
+};
+
+
+/**
+ * 말 종류별 가치 (센티폰)
+ */
+int pieceValue(PieceType type)
+{
+	switch(type)
+	{
+		case PieceType::PAWN:   return 100;
+		case PieceType::KNIGHT: return 320;
+		case PieceType::BISHOP: return 330;
+		case PieceType::ROOK:   return 500;
+		case PieceType::QUEEN:  return 900;
+		default:                return 0;
+	}
+}
+
+
+class ChessSearch
+{
+public:
+	/**
+	 * 한 깊이가 끝날 때마다 불림. (진행 상황 출력용)
+	 */
+	std::function<void(const SearchResult&)> onIteration;
+
+	ChessSearch()
+		: stopFlag(nullptr)
+	{}
+
+	/**
+	 * root의 현재 차례에서 가장 좋은 수를 찾음.
+	 * @param stop 다른 스레드에서 true로 바꾸면 최대한 빨리 멈춤. nullptr 가능
+	 * @return 마지막으로 끝까지 탐색한 깊이의 결과
+	 */
+	SearchResult search(const ChessEngine& root, const SearchLimits& limits, const std::atomic<bool>* stop)
+	{
+		StatTimer timer(PHASE_SEARCH);
+		this->stopFlag = stop;
+		this->limits = limits;
+		this->aborted = false;
+		this->nodes = 0;
+		this->startTime = std::chrono::steady_clock::now();
+
+		SearchResult result = { false, { 0, 0, 0, 0 }, 0, 0, 0, 0 };
+		ChessEngine engine(root);
+		for(int depth = 1; depth <= limits.maxDepth; depth++)
+		{
+			ChessMove best;
+			int score = this->searchRoot(engine, depth, result.hasMove ? &result.bestMove : nullptr, best);
+			if(this->aborted) break;
+
+			result.hasMove = best.srcX >= 0;
+			result.bestMove = best;
+			result.score = score;
+			result.depth = depth;
+			result.nodes = this->nodes;
+			result.ms = this->elapsedMs();
+			if(this->onIteration) this->onIteration(result);
+
+			// 둘 수가 없거나 메이트를 찾았으면 더 깊이 볼 필요 없음
+			if(!result.hasMove || score > SEARCH_MATE_SCORE - SEARCH_MAX_PLY || score < -SEARCH_MATE_SCORE + SEARCH_MAX_PLY) break;
+		}
+		result.nodes = this->nodes;
+		result.ms = this->elapsedMs();
+		return result;
+	}
+
+	/**
+	 * 차례인 쪽 기준의 정적 평가. 재료 점수 + 중앙/전진 보너스.
+	 */
+	static int evaluate(ChessEngine& engine)
+	{
+		int score = 0;
+		for(int y = 0; y < 8; y++) for(int x = 0; x < 8; x++)
+		{
+			ChessPiece* piece = engine.getPieceAt(x, y);
+			if(piece == nullptr) continue;
+
+			int value = pieceValue(piece->type);
+			int center = 7 - abs(2 * x - 7) / 2 - abs(2 * y - 7) / 2; // 1 ~ 7
+			switch(piece->type)
+			{
+				case PieceType::PAWN:
+					// 흑은 y가 커질수록, 백은 작아질수록 전진
+					value += 5 * (piece->color == PieceColor::BLACK ? y - 1 : 6 - y) + center;
+					break;
+				case PieceType::KNIGHT:
+				case PieceType::BISHOP:
+					value += 4 * center;
+					break;
+				case PieceType::QUEEN:
+					value += center;
+					break;
+				default:
+					break;
+			}
+			score += piece->color == engine.getTurn() ? value : -value;
+		}
+		return score;
+	}
+
+private:
+	const std::atomic<bool>* stopFlag;
+	SearchLimits limits;
+	bool aborted;
+	unsigned long long nodes;
+	std::chrono::steady_clock::time_point startTime;
+
+	double elapsedMs()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - this->startTime).count();
+	}
+
+	bool shouldStop()
+	{
+		if(this->aborted) return true;
+		if(this->stopFlag != nullptr && this->stopFlag->load(std::memory_order_relaxed)) this->aborted = true;
+		// 시간은 매번 재면 느려서 노드 256개마다 확인함
+		else if(this->limits.maxTimeMs > 0 && (this->nodes & 255) == 0 && this->elapsedMs() >= this->limits.maxTimeMs)
+		{
+			this->aborted = true;
+		}
+		return this->aborted;
+	}
+
+	/**
+	 * 잡는 수를 앞으로 보내고, 잡는 수끼리는 비싼 말을 싼 말로 잡는 순서대로 정렬함. (MVV-LVA)
+	 * @param first 있으면 맨 앞으로 보낼 수 (이전 깊이의 최선수)
+	 */
+	void orderMoves(ChessEngine& engine, ChessMove* moves, int moveCount, const ChessMove* first)
+	{
+		int keys[MAX_MOVES];
+		for(int i = 0; i < moveCount; i++)
+		{
+			const ChessMove& m = moves[i];
+			ChessPiece* victim = engine.getPieceAt(m.dstX, m.dstY);
+			ChessPiece* attacker = engine.getPieceAt(m.srcX, m.srcY);
+			keys[i] = victim == nullptr ? 0 : 10 * pieceValue(victim->type) - pieceValue(attacker->type) + 10000;
+			if(first != nullptr && m.srcX == first->srcX && m.srcY == first->srcY
+				&& m.dstX == first->dstX && m.dstY == first->dstY) keys[i] = 1 << 30;
+		}
+		// 수가 많지 않아서 삽입 정렬로 충분함
+		for(int i = 1; i < moveCount; i++)
+		{
+			ChessMove move = moves[i];
+			int key = keys[i], j = i - 1;
+			for(; j >= 0 && keys[j] < key; j--)
+			{
+				moves[j + 1] = moves[j];
+				keys[j + 1] = keys[j];
+			}
+			moves[j + 1] = move;
+			keys[j + 1] = key;
+		}
+	}
+
+	int searchRoot(ChessEngine& engine, int depth, const ChessMove* previousBest, ChessMove& best)
+	{
+		ChessMove moves[MAX_MOVES];
+		int moveCount = engine.generateMoves(moves);
+		this->orderMoves(engine, moves, moveCount, previousBest);
+
+		best = { -1, -1, -1, -1 };
+		if(moveCount == 0) return engine.isCheckmate(engine.getTurn()) ? -SEARCH_MATE_SCORE : 0;
+
+		int alpha = -SEARCH_MATE_SCORE - 1, beta = SEARCH_MATE_SCORE + 1;
+		for(int i = 0; i < moveCount; i++)
+		{
+			engine.playMove(moves[i]);
+			int score = -this->negamax(engine, depth - 1, 1, -beta, -alpha);
+			engine.undo();
+			if(this->aborted) return alpha;
+			if(score > alpha)
+			{
+				alpha = score;
+				best = moves[i];
+			}
+		}
+		return alpha;
+	}
+
+	int negamax(ChessEngine& engine, int depth, int ply, int alpha, int beta)
+	{
+		if(depth <= 0) return this->quiescence(engine, ply, alpha, beta);
+
+		this->nodes++;
+		chessStats.count(STAT_SEARCH_NODES);
+		if(this->shouldStop()) return 0;
+
+		// 탐색 안에서(루트 이후에) 나왔던 포지션으로 돌아오면 한 번만 반복돼도 무승부로 봄. (그대로 반복할 수 있으므로)
+		// 루트나 그 전의 게임 기록까지 거슬러 올라가는 반복은 실제 규칙대로 세 번째일 때만 무승부
+		int repetition = engine.getRepetitionDistance();
+		if(repetition > 0 && (repetition < ply || engine.countRepetitions() >= 2)) return 0;
+		if(engine.isFiftyMoveDraw()) return 0;
+
+		ChessMove moves[MAX_MOVES];
+		int moveCount = engine.generateMoves(moves);
+		if(moveCount == 0) return engine.isCheckmate(engine.getTurn()) ? -SEARCH_MATE_SCORE + ply : 0;
+		if(ply >= SEARCH_MAX_PLY) return evaluate(engine);
+		this->orderMoves(engine, moves, moveCount, nullptr);
+
+		for(int i = 0; i < moveCount; i++)
+		{
+			engine.playMove(moves[i]);
+			int score = -this->negamax(engine, depth - 1, ply + 1, -beta, -alpha);
+			engine.undo();
+			if(this->aborted) return 0;
+			if(score >= beta)
+			{
+				chessStats.countCutoff(i);
+				return beta;
+			}
+			if(score > alpha) alpha = score;
+		}
+		return alpha;
+	}
+
+	/**
+	 * 잡는 수만 끝까지 따라가서 수평선 효과를 줄임.
+	 */
+	int quiescence(ChessEngine& engine, int ply, int alpha, int beta)
+	{
+		this->nodes++;
+		chessStats.count(STAT_QUIESCENCE_NODES);
+		if(this->shouldStop()) return 0;
+
+		int standPat = evaluate(engine);
+		if(standPat >= beta) return beta;
+		if(standPat > alpha) alpha = standPat;
+		if(ply >= SEARCH_MAX_PLY) return alpha;
+
+		ChessMove moves[MAX_MOVES];
+		int moveCount = engine.generateMoves(moves);
+		int captureCount = 0;
+		for(int i = 0; i < moveCount; i++)
+		{
+			if(engine.getPieceAt(moves[i].dstX, moves[i].dstY) != nullptr) moves[captureCount++] = moves[i];
+		}
+		this->orderMoves(engine, moves, captureCount, nullptr);
+
+		for(int i = 0; i < captureCount; i++)
+		{
+			engine.playMove(moves[i]);
+			int score = -this->quiescence(engine, ply + 1, -beta, -alpha);
+			engine.undo();
+			if(this->aborted) return 0;
+			if(score >= beta)
+			{
+				chessStats.countCutoff(i);
+				return beta;
+			}
+			if(score > alpha) alpha = score;
+		}
+		return alpha;
+	}
+};
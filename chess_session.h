@@ -0,0 +1,223 @@
+#pragma once
+
+//
+// 한 프로세스에서 수만 개의 게임을 동시에 돌리기 위한 게임 세션 호스트.
+//
+// 게임마다 ChessEngine을 들고 있으면 말 객체만 32개씩 힙에 잡히기 때문에,
+// 게임 상태는 값만 들어있는 SessionGame으로 연속된 배열(풀)에 저장하고
+// 수도 엔진에 불러오지 않고 chess_position.h의 함수로 ChessPosition 위에서 바로 검사하고 둠.
+// 그래서 수를 둘 때는 힙 할당이 없음.
+//
+// 게임은 id % 워커 수로 샤드가 나뉘고, 한 게임은 항상 같은 워커만 건드리기 때문에
+// 게임 상태에는 락이 필요 없음. 요청 큐도 샤드마다 따로 있어서 전역 락이 없음.
+//
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "chess_position.h"
+
+
+enum class SessionGameStatus : unsigned char
+{
+	ACTIVE, FINISHED
+};
+
+struct SessionGame
+{
+	ChessPosition position;
+	unsigned int id;
+	unsigned short ply;
+	SessionGameStatus status;
+};
+
+
+struct SessionMoveRequest
+{
+	unsigned int gameId;
+	ChessMove move;
+};
+
+
+class GameSessionHost
+{
+public:
+	GameSessionHost(int gameCount, int workerCount)
+		: games(gameCount), shards(workerCount)
+	{
+		ChessEngine engine;
+		ChessPosition start;
+		engine.getPosition(start);
+		for(int i = 0; i < gameCount; i++)
+		{
+			this->games[i].position = start;
+			this->games[i].id = i;
+			this->games[i].ply = 0;
+			this->games[i].status = SessionGameStatus::ACTIVE;
+		}
+
+		for(int i = 0; i < workerCount; i++)
+		{
+			this->shards[i].thread = std::thread(&GameSessionHost::work, this, i);
+		}
+	}
+
+	~GameSessionHost()
+	{
+		for(Shard& shard : this->shards)
+		{
+			{
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				shard.running = false;
+			}
+			shard.wakeUp.notify_one();
+		}
+		for(Shard& shard : this->shards) shard.thread.join();
+	}
+
+	int getGameCount()
+	{
+		return this->games.size();
+	}
+
+	int getWorkerCount()
+	{
+		return this->shards.size();
+	}
+
+	/**
+	 * 게임 gameId에 수를 두라는 요청을 그 게임을 맡은 워커의 큐에 넣음. 결과는 기다리지 않음.
+	 * @return gameId가 없는 게임이면 요청을 넣지 않고 false
+	 */
+	bool submitMove(unsigned int gameId, ChessMove move)
+	{
+		if(gameId >= this->games.size()) return false;
+		Shard& shard = this->shards[gameId % this->shards.size()];
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			shard.pending.push_back({ gameId, move });
+			shard.submitted++;
+		}
+		shard.wakeUp.notify_one();
+		return true;
+	}
+
+	/**
+	 * 지금까지 넣은 요청이 모두 처리될 때까지 기다림.
+	 */
+	void waitIdle()
+	{
+		for(Shard& shard : this->shards)
+		{
+			std::unique_lock<std::mutex> lock(shard.mutex);
+			shard.idle.wait(lock, [&]() { return shard.processed.load() == shard.submitted; });
+		}
+	}
+
+	/**
+	 * 게임 상태를 읽음. waitIdle() 이후처럼 그 게임에 대한 요청이 처리 중이 아닐 때만 불러야 함.
+	 * @return gameId가 없는 게임이면 nullptr
+	 */
+	const SessionGame* getGame(unsigned int gameId)
+	{
+		if(gameId >= this->games.size()) return nullptr;
+		return &this->games[gameId];
+	}
+
+	/**
+	 * 게임을 시작 포지션으로 되돌림. getGame()과 같은 제약이 있음.
+	 * @return gameId가 없는 게임이면 false
+	 */
+	bool resetGame(unsigned int gameId, const ChessPosition& start)
+	{
+		if(gameId >= this->games.size()) return false;
+		SessionGame& game = this->games[gameId];
+		game.position = start;
+		game.ply = 0;
+		game.status = SessionGameStatus::ACTIVE;
+		return true;
+	}
+
+	unsigned long long getAcceptedCount()
+	{
+		unsigned long long count = 0;
+		for(Shard& shard : this->shards) count += shard.accepted.load(std::memory_order_relaxed);
+		return count;
+	}
+
+	unsigned long long getRejectedCount()
+	{
+		unsigned long long count = 0;
+		for(Shard& shard : this->shards) count += shard.processed.load(std::memory_order_relaxed);
+		return count - this->getAcceptedCount();
+	}
+
+	/**
+	 * 게임 풀과 요청 큐가 차지하는 바이트 수.
+	 */
+	size_t getMemoryUsage()
+	{
+		size_t bytes = this->games.capacity() * sizeof(SessionGame);
+		for(Shard& shard : this->shards)
+		{
+			bytes += sizeof(Shard) + shard.pending.capacity() * sizeof(SessionMoveRequest);
+		}
+		return bytes;
+	}
+
+private:
+	struct Shard
+	{
+		std::mutex mutex;
+		std::condition_variable wakeUp, idle;
+		std::vector<SessionMoveRequest> pending;
+		unsigned long long submitted = 0;
+		std::atomic<unsigned long long> processed { 0 }, accepted { 0 };
+		bool running = true;
+		std::thread thread;
+	};
+
+	std::vector<SessionGame> games;
+	std::vector<Shard> shards;
+
+	void work(int shardIndex)
+	{
+		Shard& shard = this->shards[shardIndex];
+		std::vector<SessionMoveRequest> batch;
+
+		while(true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(shard.mutex);
+				shard.wakeUp.wait(lock, [&]() { return !shard.pending.empty() || !shard.running; });
+				if(shard.pending.empty() && !shard.running) return;
+				// 요청을 한꺼번에 가져와서 락을 잡는 횟수를 줄임
+				batch.swap(shard.pending);
+			}
+
+			unsigned long long accepted = 0;
+			for(const SessionMoveRequest& request : batch)
+			{
+				SessionGame& game = this->games[request.gameId];
+				if(game.status != SessionGameStatus::ACTIVE) continue;
+
+				if(!playPositionMove(game.position, request.move)) continue;
+				game.ply++;
+				accepted++;
+
+				// 다음 차례인 쪽이 둘 수가 없으면 (체크메이트 또는 스테일메이트) 게임 끝
+				if(!hasPositionLegalMove(game.position)) game.status = SessionGameStatus::FINISHED;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				shard.accepted += accepted;
+				shard.processed += batch.size();
+			}
+			shard.idle.notify_all();
+			batch.clear();
+		}
+	}
+};
@@ -0,0 +1,183 @@
+#pragma once
+
+//
+// 엔진 내부 계측용 카운터.
+// -DCHESS_STATS 로 컴파일했을 때만 켜지고, 그렇지 않으면 ChessStatsT<false>가 선택돼서
+// 모든 호출이 빈 인라인 함수가 되므로 컴파일 타임에 사라짐.
+//
+
+#include <iostream>
+#include <chrono>
+
+#ifdef CHESS_STATS
+constexpr bool CHESS_STATS_ENABLED = true;
+#else
+constexpr bool CHESS_STATS_ENABLED = false;
+#endif
+
+
+enum StatCounter
+{
+	STAT_IS_PIECE_MOVABLE_TO, STAT_CHECK_PATH, STAT_SIMULATE_CHECKMATE, STAT_UPDATE_CHECKMATE,
+	STAT_SEARCH_NODES, STAT_QUIESCENCE_NODES,
+	STAT_COUNTER_COUNT
+};
+
+enum StatPhase
+{
+	PHASE_MOVE_PIECE, PHASE_SIMULATE_CHECKMATE, PHASE_UPDATE_CHECKMATE, PHASE_PRINT_BOARD, PHASE_SEARCH,
+	PHASE_COUNT
+};
+
+const char* const STAT_COUNTER_NAMES[STAT_COUNTER_COUNT] = {
+	"isPieceMovableTo", "checkPath", "simulateCheckmate", "updateCheckmate",
+	"searchNodes", "quiescenceNodes"
+};
+
+const char* const STAT_PHASE_NAMES[PHASE_COUNT] = {
+	"movePieceTo", "simulateCheckmate", "updateCheckmate", "printBoard", "search"
+};
+
+// 베타 컷이 몇 번째 수에서 났는지 세는 칸 수. 마지막 칸은 그 이후 전부
+const int STAT_CUTOFF_BUCKETS = 8;
+
+
+template<bool Enabled>
+class ChessStatsT
+{
+public:
+	unsigned long long counters[STAT_COUNTER_COUNT];
+	unsigned long long phaseNanos[PHASE_COUNT];
+	unsigned long long betaCutoffs[STAT_CUTOFF_BUCKETS];
+
+	ChessStatsT() { this->reset(); }
+
+	void reset()
+	{
+		for(int i = 0; i < STAT_COUNTER_COUNT; i++) this->counters[i] = 0;
+		for(int i = 0; i < PHASE_COUNT; i++) this->phaseNanos[i] = 0;
+		for(int i = 0; i < STAT_CUTOFF_BUCKETS; i++) this->betaCutoffs[i] = 0;
+	}
+
+	void count(StatCounter counter) { this->counters[counter]++; }
+	void addTime(StatPhase phase, unsigned long long nanos) { this->phaseNanos[phase] += nanos; }
+
+	void countCutoff(int moveIndex)
+	{
+		this->betaCutoffs[moveIndex < STAT_CUTOFF_BUCKETS - 1 ? moveIndex : STAT_CUTOFF_BUCKETS - 1]++;
+	}
+
+	void merge(const ChessStatsT& other)
+	{
+		for(int i = 0; i < STAT_COUNTER_COUNT; i++) this->counters[i] += other.counters[i];
+		for(int i = 0; i < PHASE_COUNT; i++) this->phaseNanos[i] += other.phaseNanos[i];
+		for(int i = 0; i < STAT_CUTOFF_BUCKETS; i++) this->betaCutoffs[i] += other.betaCutoffs[i];
+	}
+
+	void print(std::ostream& out) const
+	{
+		out << "[counters]" << std::endl;
+		for(int i = 0; i < STAT_COUNTER_COUNT; i++)
+		{
+			out << "  " << STAT_COUNTER_NAMES[i] << ": " << this->counters[i] << std::endl;
+		}
+		out << "[beta cutoffs by move index]" << std::endl;
+		for(int i = 0; i < STAT_CUTOFF_BUCKETS; i++)
+		{
+			out << "  " << i << (i == STAT_CUTOFF_BUCKETS - 1 ? "+" : "") << ": " << this->betaCutoffs[i] << std::endl;
+		}
+		out << "[time per phase (us)]" << std::endl;
+		for(int i = 0; i < PHASE_COUNT; i++)
+		{
+			out << "  " << STAT_PHASE_NAMES[i] << ": " << this->phaseNanos[i] / 1000 << std::endl;
+		}
+	}
+
+	void printJson(std::ostream& out) const
+	{
+		out << "{\"enabled\":true,\"counters\":{";
+		for(int i = 0; i < STAT_COUNTER_COUNT; i++)
+		{
+			if(i != 0) out << ",";
+			out << "\"" << STAT_COUNTER_NAMES[i] << "\":" << this->counters[i];
+		}
+		out << "},\"betaCutoffs\":[";
+		for(int i = 0; i < STAT_CUTOFF_BUCKETS; i++)
+		{
+			if(i != 0) out << ",";
+			out << this->betaCutoffs[i];
+		}
+		out << "],\"phaseNanos\":{";
+		for(int i = 0; i < PHASE_COUNT; i++)
+		{
+			if(i != 0) out << ",";
+			out << "\"" << STAT_PHASE_NAMES[i] << "\":" << this->phaseNanos[i];
+		}
+		out << "}}" << std::endl;
+	}
+};
+
+
+/**
+ * 계측이 꺼져 있을 때의 구현. 모든 함수가 아무것도 하지 않음.
+ */
+template<>
+class ChessStatsT<false>
+{
+public:
+	void reset() {}
+	void count(StatCounter) {}
+	void addTime(StatPhase, unsigned long long) {}
+	void countCutoff(int) {}
+	void merge(const ChessStatsT&) {}
+
+	void print(std::ostream& out) const
+	{
+		out << "Stats are disabled. Compile with -DCHESS_STATS to enable them." << std::endl;
+	}
+
+	void printJson(std::ostream& out) const
+	{
+		out << "{\"enabled\":false}" << std::endl;
+	}
+};
+
+
+typedef ChessStatsT<CHESS_STATS_ENABLED> ChessStats;
+
+/**
+ * 스레드마다 따로 잡히는 카운터. 다른 스레드의 값은 merge()로 합쳐야 함.
+ */
+thread_local ChessStats chessStats;
+
+
+/**
+ * 생성될 때부터 소멸될 때까지 걸린 시간을 phase에 더해주는 객체.
+ */
+template<bool Enabled>
+class StatTimerT
+{
+public:
+	StatTimerT(StatPhase phase_)
+		: phase(phase_), start(std::chrono::steady_clock::now())
+	{}
+
+	~StatTimerT()
+	{
+		auto elapsed = std::chrono::steady_clock::now() - this->start;
+		chessStats.addTime(this->phase, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	}
+
+private:
+	StatPhase phase;
+	std::chrono::steady_clock::time_point start;
+};
+
+template<>
+class StatTimerT<false>
+{
+public:
+	StatTimerT(StatPhase) {}
+};
+
+typedef StatTimerT<CHESS_STATS_ENABLED> StatTimer;
@@ -0,0 +1,251 @@
+//
+// 여러 워커 프로세스로 포지션을 분석하는 코디네이터/워커 실행 파일.
+//
+// 사용법:
+//   ./cluster coordinator FILE --listen ADDRESS [옵션]
+//       FILE의 포지션(FEN/EPD 한 줄에 하나)을 접속한 워커들에게 나눠주고 결과를 도착한 순서대로 JSON 한 줄씩 출력
+//   ./cluster worker --connect ADDRESS [--threads N] [--heartbeat MS] [--fail-after N]
+//       코디네이터에 접속해서 N개의 스레드로 포지션을 탐색 (기본값: 코어 수)
+//       --fail-after: 결과를 N개 보낸 후 바로 죽음 (다시 나눠주는지 확인하는 용도)
+//   ./cluster local FILE [--workers N] [--threads N] [--fail-after N] [옵션]
+//       이 컴퓨터에서 유닉스 소켓으로 워커 N개(기본값 2)를 띄워서 코디네이터와 같이 돌림.
+//       --fail-after는 첫 번째 워커에만 적용됨
+//
+//   코디네이터 옵션:
+//     --depth N        포지션마다 깊이 N까지 탐색 (기본값 4, --time과 같이 쓰면 먼저 닿는 쪽에서 멈춤)
+//     --time MS        포지션마다 MS 밀리초까지 탐색
+//     --pipeline K     워커의 스레드 하나당 미리 보내둘 포지션 수 (기본값 2)
+//     --heartbeat MS   PING 간격 (워커에도 씀). 코디네이터와 워커 중 긴 간격의 5배 동안 소식이 없으면 상대가 죽은 것으로 봄 (기본값 1000)
+//     --idle-timeout MS  접속한 워커가 하나도 없는 채로 MS 밀리초가 지나면 포기하고 끝냄 (기본값 0: 계속 기다림)
+//                      local에서는 띄운 워커가 모두 죽으면 바로 끝냄
+//     --out FILE       결과를 파일에 씀 (기본값: 표준 출력)
+//
+// 주소 형식: "unix:/tmp/chess.sock", "tcp:127.0.0.1:9000"
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "chess_engine.cpp"
+#include "chess_search.h"
+#include "chess_notation.h"
+#include "chess_cluster.h"
+
+
+void writeJsonString(FILE* out, const std::string& text)
+{
+	fputc('"', out);
+	for(char c : text)
+	{
+		if(c == '"' || c == '\\') fputc('\\', out);
+		fputc((unsigned char) c < 0x20 ? ' ' : c, out);
+	}
+	fputc('"', out);
+}
+
+
+/**
+ * @return 파일을 열 수 없으면 false
+ */
+bool loadJobs(const char* path, std::vector<ClusterJob>& jobs)
+{
+	std::ifstream file(path);
+	if(!file) return false;
+	std::string line;
+	for(int lineNumber = 1; std::getline(file, line); lineNumber++)
+	{
+		const char* text = skipSpaces(line.c_str());
+		if(*text == '\0' || *text == '#') continue;
+		ChessPosition position;
+		if(!parseFen(text, position))
+		{
+			fprintf(stderr, "%s:%d: invalid FEN, skipped\n", path, lineNumber);
+			continue;
+		}
+		// EPD 연산은 빼고 보냄
+		jobs.push_back({ (int) jobs.size(), formatFen(position) });
+	}
+	return true;
+}
+
+
+/**
+ * @param children local에서 띄운 워커 프로세스들. 끝난 프로세스는 거두고 목록에서 뺌 (coordinator면 nullptr)
+ */
+int runCoordinator(int listenFd, const ClusterSettings& settings, const std::vector<ClusterJob>& jobs, FILE* out,
+	std::vector<pid_t>* children)
+{
+	ClusterCoordinator coordinator(settings, jobs);
+	unsigned long long nodes = 0;
+	coordinator.onResult = [&](const ClusterResult& result) {
+		fprintf(out, "{\"index\":%d,\"fen\":", result.id);
+		writeJsonString(out, jobs[result.id].fen);
+		fprintf(out, ",\"move\":");
+		writeJsonString(out, result.move);
+		fprintf(out, ",\"score\":%d,\"depth\":%d,\"nodes\":%llu,\"ms\":%.1f,\"worker\":%d}\n",
+			result.score, result.depth, result.nodes, result.ms, result.workerId);
+		// 결과를 바로바로 흘려보냄
+		fflush(out);
+		nodes += result.nodes;
+	};
+	coordinator.onEvent = [](const std::string& text) {
+		fprintf(stderr, "%s\n", text.c_str());
+	};
+	if(children != nullptr)
+	{
+		// 띄운 워커가 모두 끝났으면 더 올 워커가 없음
+		coordinator.keepWaiting = [children]() {
+			for(size_t i = 0; i < children->size(); )
+			{
+				if(waitpid((*children)[i], nullptr, WNOHANG) != 0) children->erase(children->begin() + i);
+				else i++;
+			}
+			return !children->empty();
+		};
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	bool finished = coordinator.run(listenFd);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if(!finished)
+	{
+		fprintf(stderr, "Stopped with %zu of %zu positions done\n", coordinator.getDoneCount(), jobs.size());
+	}
+
+	fprintf(stderr, "%zu positions in %.2f s: %.1f positions/s, %.0f nodes/s, %zu requeued\n",
+		coordinator.getDoneCount(), seconds, coordinator.getDoneCount() / seconds, nodes / seconds, coordinator.getRequeueCount());
+	const std::vector<size_t>& counts = coordinator.getResultCounts();
+	for(size_t w = 0; w < counts.size(); w++) fprintf(stderr, "  worker %zu: %zu results\n", w, counts[w]);
+	return finished ? 0 : 1;
+}
+
+
+int main(int argc, char** argv)
+{
+	if(argc < 2)
+	{
+		fprintf(stderr, "Usage: %s coordinator FILE --listen ADDRESS [--depth N] [--time MS] [--pipeline K] [--heartbeat MS] [--idle-timeout MS] [--out FILE]\n", argv[0]);
+		fprintf(stderr, "       %s worker --connect ADDRESS [--threads N] [--heartbeat MS] [--fail-after N]\n", argv[0]);
+		fprintf(stderr, "       %s local FILE [--workers N] [--threads N] [--fail-after N] [coordinator options]\n", argv[0]);
+		return 1;
+	}
+	std::string mode = argv[1];
+	const char* jobsPath = nullptr;
+	const char* listenAddress = nullptr;
+	const char* connectAddress = nullptr;
+	const char* outPath = nullptr;
+	int maxDepth = -1, maxTimeMs = 0, pipeline = 2, heartbeatMs = 1000, idleTimeoutMs = 0;
+	int threadCount = std::thread::hardware_concurrency(), workerCount = 2, failAfter = 0;
+
+	for(int i = 2; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--listen") == 0 && i + 1 < argc) listenAddress = argv[++i];
+		else if(strcmp(argv[i], "--connect") == 0 && i + 1 < argc) connectAddress = argv[++i];
+		else if(strcmp(argv[i], "--out") == 0 && i + 1 < argc) outPath = argv[++i];
+		else if(strcmp(argv[i], "--depth") == 0 && i + 1 < argc) maxDepth = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--time") == 0 && i + 1 < argc) maxTimeMs = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) pipeline = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--heartbeat") == 0 && i + 1 < argc) heartbeatMs = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--idle-timeout") == 0 && i + 1 < argc) idleTimeoutMs = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threadCount = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--workers") == 0 && i + 1 < argc) workerCount = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--fail-after") == 0 && i + 1 < argc) failAfter = atoi(argv[++i]);
+		else if(argv[i][0] != '-' && jobsPath == nullptr) jobsPath = argv[i];
+		else
+		{
+			fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if(threadCount < 1) threadCount = 1;
+	if(heartbeatMs < 10) heartbeatMs = 10;
+
+	if(mode == "worker")
+	{
+		if(connectAddress == nullptr)
+		{
+			fprintf(stderr, "worker needs --connect ADDRESS\n");
+			return 1;
+		}
+		int fd = connectCluster(connectAddress, 5000);
+		if(fd < 0)
+		{
+			fprintf(stderr, "Cannot connect to %s\n", connectAddress);
+			return 1;
+		}
+		ClusterWorker worker(threadCount, heartbeatMs);
+		worker.failAfter = failAfter;
+		return worker.run(fd) ? 0 : 1;
+	}
+	if(mode != "coordinator" && mode != "local")
+	{
+		fprintf(stderr, "Unknown mode: %s\n", mode.c_str());
+		return 1;
+	}
+
+	std::vector<ClusterJob> jobs;
+	if(jobsPath == nullptr || !loadJobs(jobsPath, jobs))
+	{
+		fprintf(stderr, "Cannot open %s\n", jobsPath == nullptr ? "(no file)" : jobsPath);
+		return 1;
+	}
+	// 시간 제한만 주면 깊이는 탐색이 허용하는 만큼
+	if(maxDepth < 0) maxDepth = maxTimeMs > 0 ? SEARCH_MAX_PLY : 4;
+	ClusterSettings settings = { { maxDepth, maxTimeMs }, pipeline < 1 ? 1 : pipeline, heartbeatMs,
+		idleTimeoutMs < 0 ? 0 : idleTimeoutMs };
+
+	// 소켓과 워커를 만든 후에 실패하면 치워야 하므로 먼저 엶
+	FILE* out = stdout;
+	if(outPath != nullptr && (out = fopen(outPath, "w")) == nullptr)
+	{
+		fprintf(stderr, "Cannot open %s\n", outPath);
+		return 1;
+	}
+
+	std::string address;
+	if(mode == "local") address = "unix:/tmp/chess-cluster-" + std::to_string(getpid()) + ".sock";
+	else if(listenAddress != nullptr) address = listenAddress;
+	else
+	{
+		fprintf(stderr, "coordinator needs --listen ADDRESS\n");
+		return 1;
+	}
+	int listenFd = listenCluster(address);
+	if(listenFd < 0)
+	{
+		fprintf(stderr, "Cannot listen on %s\n", address.c_str());
+		return 1;
+	}
+
+	std::vector<pid_t> children;
+	if(mode == "local")
+	{
+		for(int w = 0; w < workerCount; w++)
+		{
+			pid_t pid = fork();
+			if(pid == 0)
+			{
+				close(listenFd);
+				int fd = connectCluster(address, 5000);
+				if(fd < 0) _exit(1);
+				ClusterWorker worker(threadCount, heartbeatMs);
+				worker.failAfter = w == 0 ? failAfter : 0;
+				_exit(worker.run(fd) ? 0 : 1);
+			}
+			if(pid > 0) children.push_back(pid);
+		}
+	}
+
+	int status = runCoordinator(listenFd, settings, jobs, out, mode == "local" ? &children : nullptr);
+	if(out != stdout) fclose(out);
+	close(listenFd);
+	if(address.compare(0, 5, "unix:") == 0) unlink(address.c_str() + 5);
+	for(pid_t pid : children) waitpid(pid, nullptr, 0);
+	return status;
+}
@@ -0,0 +1,351 @@
+//
+// EPD 테스트 스위트 실행 파일.
+//
+// 사용법:
+//   ./epd FILE [--depth N] [--time MS] [--threads N] [--out REPORT] [--timing FILE]
+//
+//   --depth N     포지션마다 깊이 N까지 탐색 (기본값 4, --time과 같이 쓰면 먼저 닿는 쪽에서 멈춤)
+//   --time MS     포지션마다 MS 밀리초까지 탐색 (--depth 없이 쓰면 깊이 제한 없음)
+//   --threads N   포지션을 N개의 스레드에 나눠서 탐색 (기본값: 코어 수). 스레드마다 엔진이 따로 있음
+//   --out REPORT  JSON 보고서를 파일에 씀 (기본값: 표준 출력)
+//   --timing FILE 포지션별 탐색 시간과 전체 시간, nps를 JSON으로 따로 씀
+//
+// 포지션마다 bm(찾아야 하는 수)이나 am(피해야 하는 수) 연산이 있어야 함.
+// 보고서는 포지션 하나당 한 줄이고 순서가 항상 같아서, 빌드끼리 diff로 비교할 수 있음.
+// 돌릴 때마다 달라지는 시간은 보고서에 넣지 않고 --timing 파일에만 씀.
+// (깊이 제한만 쓰면 보고서가 노드 수까지 똑같이 나옴)
+// 사람이 읽을 요약은 표준 에러로 출력함.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "chess_engine.cpp"
+#include "chess_search.h"
+#include "chess_notation.h"
+
+
+enum class EpdStatus
+{
+	SOLVED, FAILED, INVALID
+};
+
+const char* const EPD_STATUS_NAMES[] = { "solved", "failed", "invalid" };
+
+
+struct EpdCase
+{
+	std::string line, id, error;
+	EpdRecord record;
+	std::vector<std::string> bmText, amText;
+	std::vector<ChessMove> bm, am;
+
+	EpdStatus status;
+	SearchResult result;
+	std::string move;
+	// 마지막까지 답을 유지한 첫 반복의 깊이, 노드 수, 시간. 못 풀었으면 solveDepth는 -1
+	int solveDepth;
+	unsigned long long solveNodes;
+	double solveMs;
+};
+
+
+bool containsMove(const std::vector<ChessMove>& moves, const ChessMove& move)
+{
+	for(const ChessMove& m : moves)
+	{
+		if(m.srcX == move.srcX && m.srcY == move.srcY && m.dstX == move.dstX && m.dstY == move.dstY) return true;
+	}
+	return false;
+}
+
+
+/**
+ * bm이 있으면 그 중 하나를 골라야 하고, am이 있으면 그 중 아무것도 고르지 않아야 풀었다고 봄.
+ */
+bool isSolution(const EpdCase& c, const ChessMove& move)
+{
+	if(!c.bm.empty() && !containsMove(c.bm, move)) return false;
+	return !containsMove(c.am, move);
+}
+
+
+/**
+ * EPD 한 줄을 읽어서 bm/am을 엔진의 수로 바꿈. 실패하면 status가 INVALID가 되고 error에 이유가 들어감.
+ */
+void loadCase(EpdCase& c, ChessEngine& engine)
+{
+	c.status = EpdStatus::INVALID;
+	c.solveDepth = -1;
+	c.solveNodes = 0;
+	c.solveMs = 0;
+	c.result = { false, { 0, 0, 0, 0 }, 0, 0, 0, 0 };
+
+	if(!parseEpd(c.line.c_str(), c.record))
+	{
+		c.error = "malformed EPD";
+		return;
+	}
+	const EpdOperation* id = c.record.find("id");
+	if(id != nullptr && !id->operands.empty()) c.id = id->operands[0];
+
+	engine.setPosition(c.record.position);
+	const char* opcodes[2] = { "bm", "am" };
+	for(int k = 0; k < 2; k++)
+	{
+		const EpdOperation* operation = c.record.find(opcodes[k]);
+		if(operation == nullptr) continue;
+		for(const std::string& text : operation->operands)
+		{
+			ChessMove move;
+			if(!parseMove(engine, text, move))
+			{
+				// 프로모션이나 앙파상처럼 엔진이 모르는 수도 여기로 옴
+				c.error = std::string("cannot read ") + opcodes[k] + " move " + text;
+				return;
+			}
+			(k == 0 ? c.bmText : c.amText).push_back(text);
+			(k == 0 ? c.bm : c.am).push_back(move);
+		}
+	}
+	if(c.bm.empty() && c.am.empty())
+	{
+		c.error = "no bm or am operation";
+		return;
+	}
+	c.status = EpdStatus::FAILED;
+}
+
+
+void runCase(EpdCase& c, ChessEngine& engine, ChessSearch& search, const SearchLimits& limits)
+{
+	engine.setPosition(c.record.position);
+
+	// 답을 찾았다가 다시 놓치면 기록을 지워서, 마지막까지 유지한 답을 처음 찾은 때만 남김
+	bool solved = false;
+	search.onIteration = [&](const SearchResult& result) {
+		bool solvedNow = result.hasMove && isSolution(c, result.bestMove);
+		if(solvedNow && !solved)
+		{
+			c.solveDepth = result.depth;
+			c.solveNodes = result.nodes;
+			c.solveMs = result.ms;
+		}
+		else if(!solvedNow) c.solveDepth = -1;
+		solved = solvedNow;
+	};
+	c.result = search.search(engine, limits, nullptr);
+	search.onIteration = nullptr;
+
+	if(c.result.hasMove) c.move = formatSan(engine, c.result.bestMove);
+	c.status = solved ? EpdStatus::SOLVED : EpdStatus::FAILED;
+}
+
+
+void writeJsonString(std::ostream& out, const std::string& text)
+{
+	out << '"';
+	for(char c : text)
+	{
+		if(c == '"' || c == '\\') out << '\\' << c;
+		else if((unsigned char) c < 0x20) out << ' ';
+		else out << c;
+	}
+	out << '"';
+}
+
+
+void writeJsonStrings(std::ostream& out, const std::vector<std::string>& texts)
+{
+	out << '[';
+	for(size_t i = 0; i < texts.size(); i++)
+	{
+		if(i != 0) out << ',';
+		writeJsonString(out, texts[i]);
+	}
+	out << ']';
+}
+
+
+void writeReport(std::ostream& out, const char* suite, const SearchLimits& limits, int threadCount,
+	const std::vector<EpdCase>& cases, double wallMs)
+{
+	int invalid = 0, solved = 0, bmCount = 0, bmSolved = 0, amCount = 0, amSolved = 0;
+	unsigned long long nodes = 0;
+
+	out << "{\"suite\":";
+	writeJsonString(out, suite);
+	out << ",\"maxDepth\":" << limits.maxDepth << ",\"maxTimeMs\":" << limits.maxTimeMs
+		<< ",\"threads\":" << threadCount << ",\"positions\":[" << std::endl;
+	for(size_t i = 0; i < cases.size(); i++)
+	{
+		const EpdCase& c = cases[i];
+		out << "{\"index\":" << i << ",\"id\":";
+		writeJsonString(out, c.id);
+		out << ",\"status\":\"" << EPD_STATUS_NAMES[(int) c.status] << "\"";
+		if(c.status == EpdStatus::INVALID)
+		{
+			invalid++;
+			out << ",\"error\":";
+			writeJsonString(out, c.error);
+		}
+		else
+		{
+			bool isSolved = c.status == EpdStatus::SOLVED;
+			solved += isSolved;
+			if(!c.bm.empty()) { bmCount++; bmSolved += isSolved; }
+			if(!c.am.empty()) { amCount++; amSolved += isSolved; }
+			nodes += c.result.nodes;
+
+			out << ",\"bm\":";
+			writeJsonStrings(out, c.bmText);
+			out << ",\"am\":";
+			writeJsonStrings(out, c.amText);
+			out << ",\"move\":";
+			writeJsonString(out, c.move);
+			out << ",\"score\":" << c.result.score << ",\"depth\":" << c.result.depth
+				<< ",\"nodes\":" << c.result.nodes;
+			if(isSolved) out << ",\"solveDepth\":" << c.solveDepth << ",\"solveNodes\":" << c.solveNodes;
+		}
+		out << "}" << (i + 1 == cases.size() ? "" : ",") << std::endl;
+	}
+
+	int valid = cases.size() - invalid;
+	out << "],\"summary\":{\"positions\":" << cases.size() << ",\"invalid\":" << invalid
+		<< ",\"solved\":" << solved << ",\"solveRate\":" << (valid > 0 ? (double) solved / valid : 0)
+		<< ",\"bm\":{\"positions\":" << bmCount << ",\"solved\":" << bmSolved << "}"
+		<< ",\"am\":{\"positions\":" << amCount << ",\"solved\":" << amSolved << "}"
+		<< ",\"nodes\":" << nodes << "}}" << std::endl;
+
+	fprintf(stderr, "%d/%d solved (%.1f%%), %d invalid, bm %d/%d, am %d/%d, %llu nodes in %.0f ms\n",
+		solved, valid, valid > 0 ? 100.0 * solved / valid : 0.0, invalid, bmSolved, bmCount, amSolved, amCount,
+		nodes, wallMs);
+}
+
+
+/**
+ * 돌릴 때마다 달라지는 시간 값만 모은 JSON. 포지션 순서와 index는 보고서와 같음.
+ */
+void writeTiming(std::ostream& out, const std::vector<EpdCase>& cases, double wallMs)
+{
+	unsigned long long nodes = 0;
+	out << "{\"positions\":[" << std::endl;
+	for(size_t i = 0; i < cases.size(); i++)
+	{
+		const EpdCase& c = cases[i];
+		out << "{\"index\":" << i;
+		if(c.status != EpdStatus::INVALID)
+		{
+			nodes += c.result.nodes;
+			out << ",\"ms\":" << c.result.ms;
+			if(c.status == EpdStatus::SOLVED) out << ",\"solveMs\":" << c.solveMs;
+		}
+		out << "}" << (i + 1 == cases.size() ? "" : ",") << std::endl;
+	}
+	out << "],\"wallMs\":" << wallMs
+		<< ",\"nps\":" << (wallMs > 0 ? (unsigned long long) (nodes * 1000.0 / wallMs) : 0) << "}" << std::endl;
+}
+
+
+int main(int argc, char** argv)
+{
+	const char* suite = nullptr;
+	const char* reportPath = nullptr;
+	const char* timingPath = nullptr;
+	int maxDepth = -1, maxTimeMs = 0;
+	int threadCount = std::thread::hardware_concurrency();
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--depth") == 0 && i + 1 < argc) maxDepth = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--time") == 0 && i + 1 < argc) maxTimeMs = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threadCount = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--out") == 0 && i + 1 < argc) reportPath = argv[++i];
+		else if(strcmp(argv[i], "--timing") == 0 && i + 1 < argc) timingPath = argv[++i];
+		else if(argv[i][0] != '-' && suite == nullptr) suite = argv[i];
+		else
+		{
+			fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if(suite == nullptr)
+	{
+		fprintf(stderr, "Usage: %s FILE [--depth N] [--time MS] [--threads N] [--out REPORT] [--timing FILE]\n", argv[0]);
+		return 1;
+	}
+	// 시간 제한만 주면 깊이는 탐색이 허용하는 만큼
+	if(maxDepth < 0) maxDepth = maxTimeMs > 0 ? SEARCH_MAX_PLY : 4;
+	if(threadCount < 1) threadCount = 1;
+	SearchLimits limits = { maxDepth, maxTimeMs };
+
+	std::ifstream file(suite);
+	if(!file)
+	{
+		fprintf(stderr, "Cannot open %s\n", suite);
+		return 1;
+	}
+	std::vector<EpdCase> cases;
+	{
+		ChessEngine engine;
+		engine.setPhysicalEnabled(false);
+		std::string line;
+		while(std::getline(file, line))
+		{
+			const char* text = skipSpaces(line.c_str());
+			if(*text == '\0' || *text == '#') continue;
+			cases.emplace_back();
+			cases.back().line = text;
+			loadCase(cases.back(), engine);
+		}
+	}
+	if(threadCount > (int) cases.size()) threadCount = cases.size() > 0 ? cases.size() : 1;
+
+	// 포지션을 하나씩 가져가서 푸는 스레드들. 엔진과 탐색기는 스레드마다 따로 있음
+	auto start = std::chrono::steady_clock::now();
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> threads;
+	for(int t = 0; t < threadCount; t++)
+	{
+		threads.emplace_back([&]() {
+			ChessEngine engine;
+			engine.setPhysicalEnabled(false);
+			ChessSearch search;
+			for(size_t i = next++; i < cases.size(); i = next++)
+			{
+				if(cases[i].status != EpdStatus::INVALID) runCase(cases[i], engine, search, limits);
+			}
+		});
+	}
+	for(std::thread& thread : threads) thread.join();
+	double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	if(reportPath != nullptr)
+	{
+		std::ofstream report(reportPath);
+		if(!report)
+		{
+			fprintf(stderr, "Cannot open %s\n", reportPath);
+			return 1;
+		}
+		writeReport(report, suite, limits, threadCount, cases, wallMs);
+	}
+	else writeReport(std::cout, suite, limits, threadCount, cases, wallMs);
+
+	if(timingPath != nullptr)
+	{
+		std::ofstream timing(timingPath);
+		if(!timing)
+		{
+			fprintf(stderr, "Cannot open %s\n", timingPath);
+			return 1;
+		}
+		writeTiming(timing, cases, wallMs);
+	}
+	return 0;
+}
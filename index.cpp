@@ -0,0 +1,226 @@
+//
+// 포지션 인덱스 실행 파일. 게임 모음(PGN)으로 인덱스 파일을 만들고, 포지션마다 나온 게임과 다음 수 통계를 찾음.
+//
+// 사용법:
+//   ./index build GAMES.pgn INDEX [--threads N] [--run-entries N]
+//       GAMES.pgn의 게임을 N개의 스레드로 다시 둬보고 INDEX에 씀 (기본값: 코어 수)
+//       --run-entries: 메모리에 모아두는 최대 항목 수 (기본값 16M, 항목 하나에 16바이트)
+//   ./index query INDEX [--fen FEN] [--moves "e4 e5 Nf3"] [--games N]
+//       FEN(없으면 시작 포지션)에서 moves를 둔 포지션을 찾아서 다음 수 통계와 게임 번호 N개(기본값 10)를 출력
+//   ./index bench INDEX [--queries N]
+//       인덱스에 있는 포지션 N개(기본값 1000000)를 골고루 골라서 쿼리 속도를 잼
+//
+// 게임 번호는 PGN 파일에서 게임이 나온 순서 (0부터).
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "chess_engine.cpp"
+#include "chess_notation.h"
+#include "chess_index.h"
+
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+int buildIndex(const char* gamesPath, const char* indexPath, int threadCount, size_t runEntries)
+{
+	std::ifstream games(gamesPath);
+	if(!games)
+	{
+		fprintf(stderr, "Cannot open %s\n", gamesPath);
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	PositionIndexBuilder builder(threadCount, runEntries);
+	builder.onBadMove = [&](unsigned int gameId, const std::string& move) {
+		fprintf(stderr, "game %u: cannot read %s, indexed up to the previous move\n", gameId, move.c_str());
+	};
+	PositionIndexBuildStats stats;
+	if(!builder.build(games, indexPath, stats))
+	{
+		fprintf(stderr, "Cannot write %s\n", indexPath);
+		return 1;
+	}
+	double ms = elapsedMs(start);
+	printf("games: %llu (%llu with unreadable moves), positions: %llu, runs: %llu\n",
+		stats.games, stats.badGames, stats.entries, stats.runs);
+	printf("time: %.0f ms, %.0f games/s, %.0f positions/s, %d thread(s)\n",
+		ms, stats.games / ms * 1000, stats.entries / ms * 1000, threadCount);
+	return 0;
+}
+
+
+int queryIndex(const PositionIndex& index, const char* fen, const char* moves, int gameLimit)
+{
+	ChessEngine engine;
+	engine.setPhysicalEnabled(false);
+	ChessPosition position;
+	if(!parseFen(fen, position))
+	{
+		fprintf(stderr, "Invalid FEN: %s\n", fen);
+		return 1;
+	}
+	engine.setPosition(position);
+
+	std::istringstream in(moves);
+	std::string text;
+	while(in >> text)
+	{
+		ChessMove move;
+		if(!parseMove(engine, text, move))
+		{
+			fprintf(stderr, "Cannot play %s\n", text.c_str());
+			return 1;
+		}
+		engine.playMove(move);
+	}
+
+	ChessMove legal[MAX_MOVES];
+	int legalCount = engine.generateMoves(legal);
+	PositionMoveStat stats[MAX_MOVES];
+	auto start = std::chrono::steady_clock::now();
+	PositionQueryResult result = index.query(engine, stats, MAX_MOVES);
+	double ms = elapsedMs(start);
+
+	engine.getPosition(position);
+	printf("%s\n", formatFen(position).c_str());
+	printf("games: %u, occurrences: %u, ended here: %u (%.3f ms)\n", result.games, result.occurrences, result.endedHere, ms);
+	for(int i = 0; i < result.moveCount; i++)
+	{
+		const PositionMoveStat& stat = stats[i];
+		// 해시가 겹친 다른 포지션의 수일 수 있어서, 여기서 둘 수 없는 수는 SAN으로 못 바꾸고 ?로 표시
+		bool isLegal = false;
+		for(int m = 0; m < legalCount && !isLegal; m++)
+		{
+			isLegal = legal[m].srcX == stat.move.srcX && legal[m].srcY == stat.move.srcY
+				&& legal[m].dstX == stat.move.dstX && legal[m].dstY == stat.move.dstY;
+		}
+		printf("  %-8s %8u  %5.1f%%  first in game %u\n", isLegal ? formatSan(engine, stat.move, legal, legalCount).c_str() : "?",
+			stat.count, 100.0 * stat.count / result.occurrences, stat.firstGameId);
+	}
+
+	const PositionIndexEntry* first;
+	size_t count = index.find(engine.getHash(), first);
+	for(size_t i = 0; i < count && (int) i < gameLimit; i++)
+	{
+		printf("  game %u, ply %u\n", first[i].gameId, first[i].ply);
+	}
+	if(count > (size_t) gameLimit) printf("  ... %zu more\n", count - gameLimit);
+	return 0;
+}
+
+
+int benchIndex(const PositionIndex& index, long long queryCount)
+{
+	if(index.getEntryCount() == 0)
+	{
+		printf("Index is empty\n");
+		return 1;
+	}
+
+	// 항목을 골고루 골라서 쿼리함 (많이 나온 포지션일수록 많이 뽑힘)
+	PositionMoveStat stats[MAX_MOVES];
+	unsigned long long state = 0x9E3779B97F4A7C15ULL, occurrences = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(long long q = 0; q < queryCount; q++)
+	{
+		unsigned long long i = ZobristKeys::next(state) % index.getEntryCount();
+		PositionQueryResult result = index.query(index.getEntry(i).hash, stats, MAX_MOVES);
+		occurrences += result.occurrences;
+	}
+	double ms = elapsedMs(start);
+	printf("%lld queries in %.0f ms: %.2f us/query, %.1f occurrences/query\n",
+		queryCount, ms, ms * 1000 / queryCount, (double) occurrences / queryCount);
+	return 0;
+}
+
+
+int main(int argc, char** argv)
+{
+	if(argc < 3)
+	{
+		fprintf(stderr, "Usage: %s build GAMES.pgn INDEX [--threads N] [--run-entries N]\n", argv[0]);
+		fprintf(stderr, "       %s query INDEX [--fen FEN] [--moves MOVES] [--games N]\n", argv[0]);
+		fprintf(stderr, "       %s bench INDEX [--queries N]\n", argv[0]);
+		return 1;
+	}
+
+	if(strcmp(argv[1], "build") == 0)
+	{
+		if(argc < 4)
+		{
+			fprintf(stderr, "Usage: %s build GAMES.pgn INDEX [--threads N] [--run-entries N]\n", argv[0]);
+			return 1;
+		}
+		int threadCount = std::thread::hardware_concurrency();
+		size_t runEntries = 16 << 20;
+		for(int i = 4; i < argc; i++)
+		{
+			if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threadCount = atoi(argv[++i]);
+			else if(strcmp(argv[i], "--run-entries") == 0 && i + 1 < argc) runEntries = atoll(argv[++i]);
+			else
+			{
+				fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+				return 1;
+			}
+		}
+		if(threadCount < 1) threadCount = 1;
+		if(runEntries < (size_t) threadCount) runEntries = threadCount;
+		return buildIndex(argv[2], argv[3], threadCount, runEntries);
+	}
+
+	PositionIndex index;
+	if(!index.open(argv[2]))
+	{
+		fprintf(stderr, "Cannot open index %s\n", argv[2]);
+		return 1;
+	}
+
+	if(strcmp(argv[1], "query") == 0)
+	{
+		const char* fen = START_FEN;
+		const char* moves = "";
+		int gameLimit = 10;
+		for(int i = 3; i < argc; i++)
+		{
+			if(strcmp(argv[i], "--fen") == 0 && i + 1 < argc) fen = argv[++i];
+			else if(strcmp(argv[i], "--moves") == 0 && i + 1 < argc) moves = argv[++i];
+			else if(strcmp(argv[i], "--games") == 0 && i + 1 < argc) gameLimit = atoi(argv[++i]);
+			else
+			{
+				fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+				return 1;
+			}
+		}
+		return queryIndex(index, fen, moves, gameLimit);
+	}
+	if(strcmp(argv[1], "bench") == 0)
+	{
+		long long queryCount = 1000000;
+		for(int i = 3; i < argc; i++)
+		{
+			if(strcmp(argv[i], "--queries") == 0 && i + 1 < argc) queryCount = atoll(argv[++i]);
+			else
+			{
+				fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+				return 1;
+			}
+		}
+		return benchIndex(index, queryCount > 0 ? queryCount : 1);
+	}
+
+	fprintf(stderr, "Unknown command: %s\n", argv[1]);
+	return 1;
+}
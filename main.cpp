@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <string.h>
+#include <fstream>
 #include "chess_engine.cpp"
 #include "chess_engine_print.cpp"
+#include "chess_analysis.h"
 
 
 char* input_line();
@@ -10,6 +12,16 @@ int main(void)
 {
     ChessEngine engine;
     engine.resetBoard();
+
+    // 물리 체스판은 별도 스레드에서 움직이게 해서 입력 루프가 모터를 기다리지 않게 함
+    DirectActuator actuator;
+    PhysicalBoard physicalBoard(actuator);
+    engine.setPhysicalBoard(&physicalBoard);
+    unsigned int reportedFailures = 0;
+
+    // 입력을 기다리는 동안 현재 판을 미리 분석해둠
+    BackgroundAnalysis analysis(6);
+    SearchResult hint;
     char* buf = nullptr;
     char selectedX = -1, selectedY = -1;
     bool loop = true;
@@ -17,12 +29,37 @@ int main(void)
     while(loop)
     {
         engine.printBoard(std::cout, selectedX, selectedY);
-        printf("g: grab, u: ungrab, m: move, d: delete, q: quit\n");
+        if(physicalBoard.getPendingCount() > 0)
+        {
+            printf("Physical board: %u command(s) pending\n", physicalBoard.getPendingCount());
+        }
+        if(physicalBoard.getFailedCount() != reportedFailures)
+        {
+            reportedFailures = physicalBoard.getFailedCount();
+            printf("Physical board: %u command(s) failed so far\n", reportedFailures);
+        }
+        if(analysis.getHint(engine, hint))
+        {
+            printf("Hint: %c%d%c%d (depth %d, %+.2f)\n",
+                'A' + hint.bestMove.srcX, 8 - hint.bestMove.srcY, 'A' + hint.bestMove.dstX, 8 - hint.bestMove.dstY,
+                hint.depth, hint.score / 100.0);
+        }
+        if(engine.isThreefoldRepetition())
+        {
+            printf("Draw can be claimed: threefold repetition\n");
+        }
+        if(engine.isFiftyMoveDraw())
+        {
+            printf("Draw can be claimed: fifty-move rule\n");
+        }
+        printf("g: grab, u: ungrab, m: move, e: engine move, undo, redo, d: delete, stats: stats, q: quit\n");
 
 input:
         delete[] buf;
         printf("[input] ");
+        analysis.start(engine);
         buf = input_line();
+        analysis.stop();
 
         int buf_length = strlen(buf);
         if(buf_length < 1)
@@ -118,8 +155,17 @@ input:
                 break;
             }
 
-            case 'u': // ungrab
+            case 'u': // ungrab, undo
             {
+                if(strcmp(buf, "undo") == 0)
+                {
+                    // 물리 체스판에서는 움직인 말만 돌아가고, 잡혔던 말은 직접 다시 놓아야 함
+                    if(!engine.undo())
+                    {
+                        printf("Nothing to undo.\n");
+                        goto input;
+                    }
+                }
                 selectedX = -1;
                 selectedY = -1;
                 break;
@@ -198,6 +244,10 @@ input:
                     goto input;
                 }
 
+                const PhysicalPlan& plan = physicalBoard.getLastPlan();
+                printf("Physical move: %zu segment(s), %.1f squares carried, %.1f squares travelled, about %.1f s\n",
+                    plan.segments.size(), plan.carrySquares, plan.travelSquares, plan.seconds);
+
                 if(buf_length == 3)
                 {
                     selectedX = -1;
@@ -206,6 +256,83 @@ input:
                 break;
             }
 
+            case 'e': // engine move
+            {
+                if(buf_length != 1)
+                {
+                    printf("Invalid arguments count. Try again.\n");
+                    goto input;
+                }
+
+                // 백그라운드 분석 결과가 없으면 그 자리에서 얕게 탐색함
+                if(!analysis.getHint(engine, hint))
+                {
+                    ChessSearch search;
+                    hint = search.search(engine, { 3, 0 }, nullptr);
+                }
+                if(!hint.hasMove)
+                {
+                    printf("No legal moves.\n");
+                    goto input;
+                }
+
+                engine.movePieceTo(hint.bestMove.srcX, hint.bestMove.srcY, hint.bestMove.dstX, hint.bestMove.dstY);
+                printf("Engine played %c%d%c%d\n",
+                    'A' + hint.bestMove.srcX, 8 - hint.bestMove.srcY, 'A' + hint.bestMove.dstX, 8 - hint.bestMove.dstY);
+                selectedX = -1;
+                selectedY = -1;
+                break;
+            }
+
+            case 'r': // redo
+            {
+                if(strcmp(buf, "redo") != 0)
+                {
+                    printf("Not a valid command. Try again.\n");
+                    goto input;
+                }
+                if(!engine.redo())
+                {
+                    printf("Nothing to redo.\n");
+                    goto input;
+                }
+                selectedX = -1;
+                selectedY = -1;
+                break;
+            }
+
+            case 's': // stats
+            {
+                if(strcmp(buf, "stats") == 0)
+                {
+                    chessStats.print(std::cout);
+                }
+                else if(strcmp(buf, "stats json") == 0)
+                {
+                    chessStats.printJson(std::cout);
+                }
+                else if(strncmp(buf, "stats json ", 11) == 0)
+                {
+                    std::ofstream file(buf + 11);
+                    if(!file)
+                    {
+                        printf("Cannot open file. Try again. (%s)\n", buf + 11);
+                        goto input;
+                    }
+                    chessStats.printJson(file);
+                    printf("Exported to %s\n", buf + 11);
+                }
+                else if(strcmp(buf, "stats reset") == 0)
+                {
+                    chessStats.reset();
+                }
+                else
+                {
+                    printf("Not a valid command. Try again.\n");
+                }
+                goto input;
+            }
+
             case 'q':
             {
                 printf("Exiting...\n");
@@ -0,0 +1,200 @@
+//
+// 자가 대국 매치 실행 파일. 두 탐색 설정(A, B)끼리 여러 스레드로 동시에 두고 A 기준의 Elo와 SPRT 결과를 출력함.
+//
+// 사용법:
+//   ./match [옵션]
+//
+//   --a SPEC, --b SPEC     각 쪽의 탐색 설정. "depth=3", "time=50", "depth=4,time=100" 형식 (기본값 depth=2)
+//   --openings FILE        FEN/EPD 한 줄에 오프닝 하나. 없으면 시작 포지션만 씀
+//   --games N              최대 게임 수 (기본값 2000)
+//   --threads N            동시에 둘 게임 수 (기본값: 코어 수)
+//   --max-plies N          이만큼 두면 무승부 (기본값 200)
+//   --random-plies N       오프닝 뒤에 쌍마다 무작위로 둘 수 (기본값: 오프닝 파일이 없으면 8, 있으면 0)
+//   --resign SCORE MOVES   한 쪽이 SCORE 센티폰 이상 불리한 수를 MOVES번 연속으로 두면 기권 (기본값 1000 3, MOVES 0이면 끔)
+//   --draw SCORE MOVES PLY PLY수 이후로 양쪽 점수가 SCORE 이내인 수가 MOVES번 연속이면 무승부 (기본값 10 8 80)
+//   --sprt ELO0 ELO1       SPRT 가설 (기본값 0 10)
+//   --alpha A --beta B     SPRT 오류율 (기본값 0.05 0.05)
+//
+// 깊이만 제한하면 탐색 결과가 항상 같아서, 무작위 수가 없으면 (오프닝 수 * 2)판 이후로는 같은 게임이 반복됨.
+// 그런 게임은 독립된 표본이 아니라서 이 경우에는 게임 수를 (오프닝 수 * 2)로 줄임.
+//
+// 한 프로세스 안의 두 설정끼리만 비교할 수 있음. 두 빌드를 비교하려면 각 빌드에서
+// 같은 기준 설정(--b)을 상대로 매치를 돌려서 Elo를 비교함.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "chess_engine.cpp"
+#include "chess_search.h"
+#include "chess_notation.h"
+#include "chess_match.h"
+
+
+/**
+ * "depth=3,time=50" 형식의 설정을 읽음.
+ * @return 형식이 맞지 않으면 false
+ */
+bool parsePlayer(const char* spec, MatchPlayer& player)
+{
+	player.limits = { 0, 0 };
+	std::string text = spec;
+	size_t start = 0;
+	while(start <= text.size())
+	{
+		size_t end = text.find(',', start);
+		if(end == std::string::npos) end = text.size();
+		std::string item = text.substr(start, end - start);
+		if(item.compare(0, 6, "depth=") == 0) player.limits.maxDepth = atoi(item.c_str() + 6);
+		else if(item.compare(0, 5, "time=") == 0) player.limits.maxTimeMs = atoi(item.c_str() + 5);
+		else return false;
+		start = end + 1;
+	}
+	// 시간 제한만 주면 깊이는 탐색이 허용하는 만큼
+	if(player.limits.maxDepth <= 0) player.limits.maxDepth = player.limits.maxTimeMs > 0 ? SEARCH_MAX_PLY : 2;
+	return true;
+}
+
+
+void printProgress(const MatchTally& tally, const MatchSettings& settings, double seconds)
+{
+	double elo, error;
+	tally.elo(elo, error);
+	fprintf(stderr, "games %llu: +%llu =%llu -%llu, elo %+.1f +/- %.1f, llr %.2f, %.2f games/s\n",
+		tally.games(), tally.wins, tally.draws, tally.losses, elo, error,
+		tally.llr(settings.elo0, settings.elo1), tally.games() / seconds);
+}
+
+
+int main(int argc, char** argv)
+{
+	MatchSettings settings;
+	settings.a.limits = { 2, 0 };
+	settings.b.limits = { 2, 0 };
+	settings.maxGames = 2000;
+	settings.threadCount = std::thread::hardware_concurrency();
+	settings.maxPlies = 200;
+	settings.randomPlies = -1;
+	settings.resignScore = 1000; settings.resignMoves = 3;
+	settings.drawScore = 10; settings.drawMoves = 8; settings.drawPly = 80;
+	settings.elo0 = 0; settings.elo1 = 10;
+	settings.alpha = 0.05; settings.beta = 0.05;
+	const char* openingsPath = nullptr;
+
+	for(int i = 1; i < argc; i++)
+	{
+		bool ok = true;
+		if(strcmp(argv[i], "--a") == 0 && i + 1 < argc) ok = parsePlayer(argv[++i], settings.a);
+		else if(strcmp(argv[i], "--b") == 0 && i + 1 < argc) ok = parsePlayer(argv[++i], settings.b);
+		else if(strcmp(argv[i], "--openings") == 0 && i + 1 < argc) openingsPath = argv[++i];
+		else if(strcmp(argv[i], "--games") == 0 && i + 1 < argc) settings.maxGames = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc) settings.threadCount = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--max-plies") == 0 && i + 1 < argc) settings.maxPlies = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--random-plies") == 0 && i + 1 < argc) settings.randomPlies = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--resign") == 0 && i + 2 < argc)
+		{
+			settings.resignScore = atoi(argv[++i]);
+			settings.resignMoves = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--draw") == 0 && i + 3 < argc)
+		{
+			settings.drawScore = atoi(argv[++i]);
+			settings.drawMoves = atoi(argv[++i]);
+			settings.drawPly = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--sprt") == 0 && i + 2 < argc)
+		{
+			settings.elo0 = atof(argv[++i]);
+			settings.elo1 = atof(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--alpha") == 0 && i + 1 < argc) settings.alpha = atof(argv[++i]);
+		else if(strcmp(argv[i], "--beta") == 0 && i + 1 < argc) settings.beta = atof(argv[++i]);
+		else ok = false;
+
+		if(!ok)
+		{
+			fprintf(stderr, "Invalid argument: %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if(settings.threadCount < 1) settings.threadCount = 1;
+
+	std::vector<ChessPosition> openings;
+	if(openingsPath != nullptr)
+	{
+		std::ifstream file(openingsPath);
+		if(!file)
+		{
+			fprintf(stderr, "Cannot open %s\n", openingsPath);
+			return 1;
+		}
+		std::string line;
+		for(int lineNumber = 1; std::getline(file, line); lineNumber++)
+		{
+			const char* text = skipSpaces(line.c_str());
+			if(*text == '\0' || *text == '#') continue;
+			ChessPosition position;
+			if(!parseFen(text, position))
+			{
+				fprintf(stderr, "%s:%d: invalid FEN, skipped\n", openingsPath, lineNumber);
+				continue;
+			}
+			openings.push_back(position);
+		}
+	}
+	if(openings.empty())
+	{
+		ChessPosition start;
+		parseFen(START_FEN, start);
+		openings.push_back(start);
+	}
+	if(settings.randomPlies < 0) settings.randomPlies = openingsPath == nullptr ? 8 : 0;
+	if(openingsPath == nullptr)
+	{
+		fprintf(stderr, "warning: no --openings file, every pair starts from the start position + %d random plies\n",
+			settings.randomPlies);
+	}
+	// 깊이만 제한하고 무작위 수도 없으면 (오프닝 수 * 2)판 이후는 앞 게임의 반복일 뿐임
+	bool deterministic = settings.a.limits.maxTimeMs == 0 && settings.b.limits.maxTimeMs == 0 && settings.randomPlies == 0;
+	if(deterministic && settings.maxGames > 2 * (int) openings.size())
+	{
+		fprintf(stderr, "warning: depth-only search without random plies repeats games after %zu games, limiting --games to %zu\n",
+			2 * openings.size(), 2 * openings.size());
+		settings.maxGames = 2 * openings.size();
+	}
+
+	fprintf(stderr, "A: depth %d, %d ms / B: depth %d, %d ms / %zu opening(s) + %d random plies, %d thread(s)\n",
+		settings.a.limits.maxDepth, settings.a.limits.maxTimeMs, settings.b.limits.maxDepth, settings.b.limits.maxTimeMs,
+		openings.size(), settings.randomPlies, settings.threadCount);
+
+	MatchRunner runner(settings, openings);
+	runner.onGame = [&](const MatchTally& tally) {
+		// 20판마다 한 번씩
+		if(tally.games() % 20 == 0) printProgress(tally, settings, runner.elapsedSeconds());
+	};
+	MatchTally tally = runner.run();
+	double seconds = runner.elapsedSeconds();
+
+	double elo, error;
+	tally.elo(elo, error);
+	double llr = tally.llr(settings.elo0, settings.elo1);
+	SprtState state = sprtState(llr, settings.alpha, settings.beta);
+
+	printf("Games: %llu (+%llu =%llu -%llu), score %.1f%%\n",
+		tally.games(), tally.wins, tally.draws, tally.losses, 100 * tally.score());
+	printf("Elo: %+.1f +/- %.1f (95%%)\n", elo, error);
+	printf("SPRT: elo0 %.1f elo1 %.1f, llr %.2f [%.2f, %.2f] -> %s\n",
+		settings.elo0, settings.elo1, llr, log(settings.beta / (1 - settings.alpha)), log((1 - settings.beta) / settings.alpha),
+		state == SprtState::ACCEPT_H1 ? "H1 accepted (A is stronger)"
+		: state == SprtState::ACCEPT_H0 ? "H0 accepted (no improvement)" : "inconclusive");
+	printf("Speed: %.2f games/s, %.1f plies/game, %.1f s total\n",
+		tally.games() / seconds, tally.games() == 0 ? 0.0 : (double) tally.plies / tally.games(), seconds);
+	for(int i = 0; i < END_REASON_COUNT; i++)
+	{
+		if(tally.reasons[i] > 0) printf("  %s: %llu\n", MATCH_END_REASON_NAMES[i], tally.reasons[i]);
+	}
+	return 0;
+}